@@ -4,9 +4,13 @@
 
 #include "application.h"
 
+#include "bitboard.h"
+#include "capabilities.h"
 #include "charsets.h"
 #include "common_dialog.h"
 #include "dialog.h"
+#include "macros.h"
+#include "os.h"
 
 #include <format>
 
@@ -21,6 +25,7 @@ namespace {
         file_exit,
 
         edit_undo,
+        edit_redo,
         edit_cut,
         edit_copy,
         edit_paste,
@@ -33,10 +38,34 @@ namespace {
         view_prev_used,
         view_double,
         view_reverse,
+        view_compact,
+        view_sixel,
+        view_charmap,
+        view_sample,
+        view_sample_edit,
+
+        draw_line,
+        draw_rectangle,
+        draw_ellipse,
+        draw_fill,
+        draw_fill_8way,
 
         transform_invert,
         transform_flip_h,
         transform_flip_v,
+        transform_rotate_right,
+        transform_rotate_left,
+        transform_rotate_half,
+        transform_shift_up,
+        transform_shift_down,
+        transform_shift_left,
+        transform_shift_right,
+        transform_bold,
+        transform_outline,
+        transform_erode,
+        transform_dilate,
+        transform_thin,
+        transform_multiple,
 
         help_view,
         help_about
@@ -50,6 +79,16 @@ namespace {
     const auto buffers = std::vector{L"First empty buffer"s, L"Buffer #1"s, L"Buffer #2"s};
     const auto erase_types = std::vector{L"All of this buffer"s, L"Only the used characters"s, L"All buffers"s};
     const auto c1_types = std::vector{L"7-bit controls"s, L"8-bit controls"s};
+    const auto transform_names = std::vector{
+        L"Invert Pixels"s, L"Flip Horizontally"s, L"Flip Vertically"s,
+        L"Rotate Right"s, L"Rotate Left"s, L"Rotate Half Turn"s,
+        L"Shift Up"s, L"Shift Down"s, L"Shift Left"s, L"Shift Right"s,
+        L"Bold"s, L"Outline"s, L"Erode"s, L"Dilate"s, L"Thin"s};
+    const auto transform_functions = std::vector<std::function<void(bitboard&)>>{
+        [](auto& b) { b.invert(); }, [](auto& b) { b.flip_horizontally(); }, [](auto& b) { b.flip_vertically(); },
+        [](auto& b) { b.rotate(1); }, [](auto& b) { b.rotate(3); }, [](auto& b) { b.rotate(2); },
+        [](auto& b) { b.shift(0, -1); }, [](auto& b) { b.shift(0, 1); }, [](auto& b) { b.shift(-1, 0); }, [](auto& b) { b.shift(1, 0); },
+        [](auto& b) { b.embolden(); }, [](auto& b) { b.outline(); }, [](auto& b) { b.erode(); }, [](auto& b) { b.dilate(); }, [](auto& b) { b.thin(); }};
 
     constexpr auto widths = std::array{10, 12, 10, 15, 10, 16};
     constexpr auto heights = std::array{16, 30, 20, 12, 10, 32};
@@ -63,9 +102,11 @@ namespace {
 }  // namespace
 
 application::application(capabilities& caps, const std::filesystem::path& filepath)
-    : _caps{caps}, _status{caps}, _canvas{caps, _glyphs, _status}
+    : _caps{caps}, _status{caps}, _canvas{caps, _glyphs, _status}, _preview_font{_glyphs}, _sample_text{caps, _preview_font}, _charmap{_glyphs, _preview_font}
 {
     _init_menu();
+    _canvas.on_render([&] { _sample_text.render(); });
+    _menu.enable(id::view_sixel, _caps.has_sixel);
     _menu.render();
     _canvas.render();
     _status.render();
@@ -76,8 +117,24 @@ application::application(capabilities& caps, const std::filesystem::path& filepa
 void application::run()
 {
     for (auto exit = false; !exit;) {
+        // Commit any outstanding edits to the glyph manager, which records
+        // them in the journal.
+        _canvas.flush();
+        _preview_font.update();
+        _autosave();
         _menu.enable(id::edit_undo, _canvas.can_undo());
+        _menu.enable(id::edit_redo, _canvas.can_redo());
         _menu.enable(id::edit_paste, _canvas.can_paste());
+        // While we're waiting for input, finish any interrupted render, then
+        // upload outstanding macros, and render the neighbouring glyphs.
+        while (!os::has_input() && (_canvas.resume_render() || macro_manager::upload_pending() || _canvas.prefetch()))
+            vtout.flush();
+        // Edits to the preview font are held back until there's a pause in
+        // the input, so they can be uploaded in a single batch.
+        if (const auto delay = _preview_font.upload_delay(); delay && !os::has_input(delay.value())) {
+            _preview_font.upload();
+            vtout.flush();
+        }
         const auto key_press = keyboard::read();
         const auto selection = _menu.process_key(key_press);
         if (selection) {
@@ -90,6 +147,7 @@ void application::run()
                 case id::file_exit: exit = _exit(); break;
 
                 case id::edit_undo: _canvas.undo(); break;
+                case id::edit_redo: _canvas.redo(); break;
                 case id::edit_cut: _canvas.cut_selection(); break;
                 case id::edit_copy: _canvas.copy_selection(); break;
                 case id::edit_paste: _canvas.paste(); break;
@@ -102,10 +160,34 @@ void application::run()
                 case id::view_prev_used: _canvas.prev_char(true); break;
                 case id::view_double: _canvas.toggle_double_width(); break;
                 case id::view_reverse: _canvas.toggle_reverse_screen(); break;
+                case id::view_compact: _canvas.toggle_compact_view(); break;
+                case id::view_sixel: _canvas.toggle_sixel_view(); break;
+                case id::view_charmap: _character_map(); break;
+                case id::view_sample: _sample_text.toggle(); break;
+                case id::view_sample_edit: _sample_text.edit(); break;
+
+                case id::draw_line: _canvas.draw_line(); break;
+                case id::draw_rectangle: _canvas.draw_rectangle(); break;
+                case id::draw_ellipse: _canvas.draw_ellipse(); break;
+                case id::draw_fill: _canvas.flood_fill(false); break;
+                case id::draw_fill_8way: _canvas.flood_fill(true); break;
 
                 case id::transform_invert: _canvas.invert(); break;
                 case id::transform_flip_h: _canvas.flip_horizontally(); break;
                 case id::transform_flip_v: _canvas.flip_vertically(); break;
+                case id::transform_rotate_right: _canvas.rotate(1); break;
+                case id::transform_rotate_left: _canvas.rotate(3); break;
+                case id::transform_rotate_half: _canvas.rotate(2); break;
+                case id::transform_shift_up: _canvas.shift(0, -1); break;
+                case id::transform_shift_down: _canvas.shift(0, 1); break;
+                case id::transform_shift_left: _canvas.shift(-1, 0); break;
+                case id::transform_shift_right: _canvas.shift(1, 0); break;
+                case id::transform_bold: _canvas.embolden(); break;
+                case id::transform_outline: _canvas.outline(); break;
+                case id::transform_erode: _canvas.erode(); break;
+                case id::transform_dilate: _canvas.dilate(); break;
+                case id::transform_thin: _canvas.thin(); break;
+                case id::transform_multiple: _transform_multiple(); break;
 
                 case id::help_about: _about(); break;
             }
@@ -115,6 +197,23 @@ void application::run()
     }
 }
 
+void application::_autosave()
+{
+    // Once a background save has finished, the journal entries it covers
+    // are no longer needed.
+    if (const auto result = _autosaver.completed(); result)
+        _glyphs.autosaved(result->first, result->second);
+    // Taking a snapshot is cheap, since the glyph table is shared until the
+    // next edit, so the main loop is never held up by the file write.
+    const auto now = std::chrono::steady_clock::now();
+    if (now - _last_autosave < autosave_interval) return;
+    if (!_glyphs.modified_since_snapshot() || _autosaver.busy()) return;
+    auto snapshot = _glyphs.take_snapshot();
+    if (snapshot.autosave_path().empty()) return;
+    _autosaver.start(std::move(snapshot));
+    _last_autosave = now;
+}
+
 void application::_init_menu()
 {
     auto file_menu = _menu.add(L"&File");
@@ -128,6 +227,7 @@ void application::_init_menu()
     file_menu.add(id::file_exit, L"E&xit");
     auto edit_menu = _menu.add(L"&Edit");
     edit_menu.add(id::edit_undo, L"&Undo", key::ctrl + key::z);
+    edit_menu.add(id::edit_redo, L"&Redo", key::ctrl + key::y);
     edit_menu.separator();
     edit_menu.add(id::edit_cut, L"Cu&t", key::ctrl + key::x, key::shift + key::del);
     edit_menu.add(id::edit_copy, L"&Copy", key::ctrl + key::c, key::ctrl + key::ins);
@@ -143,10 +243,40 @@ void application::_init_menu()
     view_menu.separator();
     view_menu.add(id::view_double, L"&Double Width");
     view_menu.add(id::view_reverse, L"&Reverse Video");
+    view_menu.add(id::view_compact, L"&Compact View");
+    view_menu.add(id::view_sixel, L"Si&xel Graphics");
+    view_menu.separator();
+    view_menu.add(id::view_charmap, L"Character &Map...");
+    view_menu.add(id::view_sample, L"Sample &Text");
+    view_menu.add(id::view_sample_edit, L"&Edit Sample Text...");
+    auto draw_menu = _menu.add(L"&Draw");
+    draw_menu.add(id::draw_line, L"&Line");
+    draw_menu.add(id::draw_rectangle, L"&Rectangle");
+    draw_menu.add(id::draw_ellipse, L"&Ellipse");
+    draw_menu.separator();
+    draw_menu.add(id::draw_fill, L"&Fill", key::ctrl + key::f);
+    draw_menu.add(id::draw_fill_8way, L"Fill &Diagonally");
     auto transform_menu = _menu.add(L"&Transform");
     transform_menu.add(id::transform_invert, L"&Invert Pixels");
     transform_menu.add(id::transform_flip_h, L"Flip &Horizontally");
     transform_menu.add(id::transform_flip_v, L"Flip &Vertically");
+    transform_menu.separator();
+    transform_menu.add(id::transform_rotate_right, L"Rotate &Right");
+    transform_menu.add(id::transform_rotate_left, L"Rotate &Left");
+    transform_menu.add(id::transform_rotate_half, L"Rotate Half &Turn");
+    transform_menu.separator();
+    transform_menu.add(id::transform_shift_up, L"Shift &Up", key::ctrl + key::up);
+    transform_menu.add(id::transform_shift_down, L"Shift &Down", key::ctrl + key::down);
+    transform_menu.add(id::transform_shift_left, L"Shift Le&ft", key::ctrl + key::left);
+    transform_menu.add(id::transform_shift_right, L"Shift Ri&ght", key::ctrl + key::right);
+    transform_menu.separator();
+    transform_menu.add(id::transform_bold, L"&Bold");
+    transform_menu.add(id::transform_outline, L"&Outline");
+    transform_menu.add(id::transform_erode, L"&Erode");
+    transform_menu.add(id::transform_dilate, L"Dil&ate");
+    transform_menu.add(id::transform_thin, L"Thi&n");
+    transform_menu.separator();
+    transform_menu.add(id::transform_multiple, L"&Multiple Glyphs...");
     auto help_menu = _menu.add(L"&Help");
     help_menu.add(id::help_view, L"&View Help", key::pf1, key::help);
     help_menu.separator();
@@ -156,6 +286,11 @@ void application::_init_menu()
 bool application::_can_clear()
 {
     _canvas.flush();
+    // An autosave still in progress could otherwise be written after the
+    // font has been saved or discarded.
+    _autosaver.wait();
+    if (const auto result = _autosaver.completed(); result)
+        _glyphs.autosaved(result->first, result->second);
     if (!_status.dirty())
         return true;
     else {
@@ -164,7 +299,11 @@ bool application::_can_clear()
         using id = common_dialog::id;
         switch (common_dialog::message_box(wname, message, id::yes | id::no | id::cancel)) {
             case id::yes: return _save();
-            case id::no: return true;
+            case id::no:
+                // If the changes weren't saved, the user doesn't want them
+                // recovered.
+                _glyphs.discard_unsaved();
+                return true;
             default: return false;
         }
     }
@@ -327,8 +466,12 @@ bool application::_open(const std::filesystem::path& filepath)
     _filepath = filepath;
     _status.filename(filepath.filename().wstring());
     _status.character_set(_glyphs.id(), _glyphs.size());
-    _status.dirty(false);
+    _status.dirty(_glyphs.recovered());
     _canvas.refresh();
+    if (_glyphs.recovered()) {
+        const auto message = filename + L"\nUnsaved changes from a previous session\nhave been recovered.";
+        common_dialog::message_box(wname, message, id::ok);
+    }
     return true;
 }
 
@@ -387,6 +530,38 @@ void application::_properties()
     }
 }
 
+void application::_character_map()
+{
+    _canvas.flush();
+    const auto index = _charmap.show(_status.index());
+    if (index) _canvas.select_char(index.value());
+}
+
+void application::_transform_multiple()
+{
+    const auto min_index = _glyphs.size() == 96 ? 0 : 1;
+    const auto max_index = _glyphs.size() == 96 ? 95 : 94;
+    auto glyph_names = std::vector<std::wstring>{};
+    for (auto i = min_index; i <= max_index; i++)
+        glyph_names.push_back(std::format(L"0x{:02X}", 0x20 + i));
+
+    auto dlg = dialog{L"Transform Multiple Glyphs"};
+    auto& transform_field = dlg.add_dropdown(L"Transform", transform_names);
+    auto& first_field = dlg.add_dropdown(L"First glyph", glyph_names);
+    auto& last_field = dlg.add_dropdown(L"Last glyph", glyph_names);
+    auto& buttons = dlg.add_group(dialog::alignment::right);
+    buttons.add_button(L"OK", 1, true);
+    buttons.add_button(L"Cancel", 2);
+
+    last_field.selection(glyph_names.size() - 1);
+
+    if (dlg.show() == 1) {
+        const auto first_index = min_index + std::min(first_field.selection(), last_field.selection());
+        const auto last_index = min_index + std::max(first_field.selection(), last_field.selection());
+        _canvas.transform_glyphs(first_index, last_index, transform_functions[transform_field.selection()]);
+    }
+}
+
 bool application::_exit()
 {
     return _can_clear();
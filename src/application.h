@@ -4,11 +4,15 @@
 
 #pragma once
 
+#include "autosave.h"
 #include "canvas.h"
+#include "charmap.h"
 #include "glyphs.h"
 #include "menu.h"
+#include "preview.h"
 #include "status.h"
 
+#include <chrono>
 #include <filesystem>
 
 class capabilities;
@@ -26,6 +30,7 @@ public:
 
 private:
     void _init_menu();
+    void _autosave();
     bool _can_clear();
     bool _clear(const bool use_defaults);
     void _new(const bool use_defaults = false);
@@ -34,6 +39,8 @@ private:
     bool _open();
     bool _open(const std::filesystem::path& filepath);
     void _properties();
+    void _character_map();
+    void _transform_multiple();
     bool _exit();
     void _about();
 
@@ -42,5 +49,11 @@ private:
     status _status;
     glyph_manager _glyphs;
     canvas _canvas;
+    preview_font _preview_font;
+    sample_text _sample_text;
+    character_map _charmap;
     std::filesystem::path _filepath;
+    autosave _autosaver;
+    std::chrono::steady_clock::time_point _last_autosave;
+    static constexpr auto autosave_interval = std::chrono::seconds{30};
 };
@@ -0,0 +1,67 @@
+// VT Font Maker
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#include "autosave.h"
+
+autosave::autosave()
+{
+    _thread = std::thread{&autosave::_run, this};
+}
+
+autosave::~autosave()
+{
+    {
+        auto lock = std::lock_guard{_mutex};
+        _stopping = true;
+    }
+    _condition.notify_all();
+    _thread.join();
+}
+
+bool autosave::busy() const
+{
+    auto lock = std::lock_guard{_mutex};
+    return _busy;
+}
+
+void autosave::start(glyph_manager::snapshot snapshot)
+{
+    {
+        auto lock = std::lock_guard{_mutex};
+        _pending = std::move(snapshot);
+        _busy = true;
+    }
+    _condition.notify_all();
+}
+
+std::optional<autosave::result> autosave::completed()
+{
+    auto lock = std::lock_guard{_mutex};
+    return std::exchange(_completed, std::nullopt);
+}
+
+void autosave::wait()
+{
+    auto lock = std::unique_lock{_mutex};
+    _condition.wait(lock, [&] { return !_busy; });
+}
+
+void autosave::_run()
+{
+    auto lock = std::unique_lock{_mutex};
+    for (;;) {
+        _condition.wait(lock, [&] { return _stopping || _pending; });
+        if (_stopping) return;
+        auto snapshot = std::move(*_pending);
+        _pending.reset();
+        // The snapshot doesn't share anything mutable with the glyph
+        // manager, so it can be written without holding the lock.
+        lock.unlock();
+        const auto success = snapshot.write(snapshot.autosave_path());
+        lock.lock();
+        _completed = result{std::move(snapshot), success};
+        _busy = false;
+        _condition.notify_all();
+    }
+}
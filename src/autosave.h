@@ -0,0 +1,36 @@
+// VT Font Maker
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#pragma once
+
+#include "glyphs.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+
+class autosave {
+public:
+    using result = std::pair<glyph_manager::snapshot, bool>;
+
+    autosave();
+    ~autosave();
+    bool busy() const;
+    void start(glyph_manager::snapshot snapshot);
+    std::optional<result> completed();
+    void wait();
+
+private:
+    void _run();
+
+    mutable std::mutex _mutex;
+    std::condition_variable _condition;
+    std::optional<glyph_manager::snapshot> _pending;
+    std::optional<result> _completed;
+    bool _busy = false;
+    bool _stopping = false;
+    std::thread _thread;
+};
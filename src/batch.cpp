@@ -0,0 +1,173 @@
+// VT Font Maker
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#include "batch.h"
+
+#include "charsets.h"
+#include "glyphs.h"
+#include "pool.h"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <optional>
+
+namespace {
+
+    constexpr auto usage = R"(Usage: vtfontbatch [OPTIONS] FILE...
+
+Options:
+  --normalize        re-encode the sixels of every glyph in a consistent form
+  --controls=7|8     re-encode the font with 7-bit or 8-bit C1 controls
+  --charset=DSCS     retarget the font to the given character set
+  --buffer=0|1|2     retarget the font to the given font buffer
+  --output=DIR       save the processed fonts in DIR
+  --in-place         save the processed fonts over the originals
+  --jobs=N           number of worker threads (defaults to the core count)
+)";
+
+    struct options {
+        bool normalize = false;
+        std::optional<bool> c1_8bit;
+        std::optional<std::string> charset_id;
+        std::optional<int> buffer;
+        std::filesystem::path output_dir;
+        bool in_place = false;
+        int jobs = 0;
+        std::vector<std::filesystem::path> files;
+    };
+
+    struct result {
+        std::string error;
+        std::uintmax_t bytes = 0;
+        int glyphs = 0;
+    };
+
+    std::optional<int> parse_int(const std::string_view s)
+    {
+        if (s.empty() || s.length() > 4) return {};
+        auto value = 0;
+        for (const auto ch : s) {
+            if (ch < '0' || ch > '9') return {};
+            value = value * 10 + (ch - '0');
+        }
+        return value;
+    }
+
+    std::optional<options> parse_options(const std::vector<std::string>& args)
+    {
+        auto opts = options{};
+        for (const auto& arg : args) {
+            const auto equals = arg.find('=');
+            const auto name = arg.substr(0, equals);
+            const auto value = equals != std::string::npos ? arg.substr(equals + 1) : "";
+            if (!arg.starts_with("-"))
+                opts.files.emplace_back(arg);
+            else if (arg == "--normalize")
+                opts.normalize = true;
+            else if (arg == "--in-place")
+                opts.in_place = true;
+            else if (name == "--controls" && (value == "7" || value == "8"))
+                opts.c1_8bit = value == "8";
+            else if (name == "--charset" && !value.empty())
+                opts.charset_id = value;
+            else if (name == "--buffer" && parse_int(value).value_or(3) <= 2)
+                opts.buffer = parse_int(value);
+            else if (name == "--output" && !value.empty())
+                opts.output_dir = value;
+            else if (name == "--jobs" && parse_int(value).value_or(0) > 0)
+                opts.jobs = parse_int(value).value();
+            else
+                return {};
+        }
+        if (opts.files.empty() || (opts.in_place && !opts.output_dir.empty()))
+            return {};
+        return opts;
+    }
+
+    result process(const options& opts, const std::filesystem::path& path)
+    {
+        // Fonts are loaded without recovery, so we're working with what's
+        // actually in the file, and nothing gets journalled.
+        auto glyphs = glyph_manager{};
+        auto error = std::error_code{};
+        const auto bytes = std::filesystem::file_size(path, error);
+        if (error || !glyphs.load(path, false))
+            return {"not a valid font file"};
+
+        if (opts.normalize)
+            glyphs.normalize();
+        if (opts.c1_8bit) {
+            if (!glyphs.c1_controls())
+                return {"control format can't be changed"};
+            glyphs.c1_controls(opts.c1_8bit.value());
+        }
+        if (opts.charset_id) {
+            if (!charset::index_of(opts.charset_id.value(), glyphs.size()))
+                return {std::format("{} is not a {}-character set", opts.charset_id.value(), glyphs.size())};
+            glyphs.id(opts.charset_id.value());
+        }
+        if (opts.buffer)
+            glyphs.params().pfn(opts.buffer.value());
+
+        if (opts.in_place || !opts.output_dir.empty()) {
+            const auto output_path = opts.in_place ? path : opts.output_dir / path.filename();
+            if (!glyphs.save(output_path))
+                return {std::format("unable to save {}", output_path.string())};
+        }
+        return {{}, bytes, glyphs.size()};
+    }
+
+}  // namespace
+
+int batch::run(const std::vector<std::string>& args)
+{
+    // This runs without a terminal, so nothing here may use the os class or
+    // vtout. Results are written to stdout, and errors to stderr.
+    const auto opts = parse_options(args);
+    if (!opts) {
+        std::cerr << usage;
+        return 2;
+    }
+    if (!opts->output_dir.empty()) {
+        auto error = std::error_code{};
+        std::filesystem::create_directories(opts->output_dir, error);
+        if (error) {
+            std::cerr << std::format("{}: {}\n", opts->output_dir.string(), error.message());
+            return 1;
+        }
+    }
+
+    // Each file is a separate task, and the results are collected by index,
+    // so the workers don't need to share anything else.
+    auto results = std::vector<result>(opts->files.size());
+    auto tasks = std::vector<work_pool::task>{};
+    for (auto i = std::size_t{0}; i < opts->files.size(); i++)
+        tasks.push_back([&, i] { results[i] = process(opts.value(), opts->files[i]); });
+
+    auto pool = work_pool{opts->jobs};
+    const auto start_time = std::chrono::steady_clock::now();
+    pool.run(std::move(tasks));
+    const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+    auto failures = 0;
+    auto total_bytes = std::uintmax_t{0};
+    auto total_glyphs = 0;
+    for (auto i = std::size_t{0}; i < results.size(); i++) {
+        if (!results[i].error.empty()) {
+            std::cerr << std::format("{}: {}\n", opts->files[i].string(), results[i].error);
+            failures++;
+        }
+        total_bytes += results[i].bytes;
+        total_glyphs += results[i].glyphs;
+    }
+    const auto processed = int(results.size()) - failures;
+    const auto rate = [&](const double count) { return elapsed > 0 ? count / elapsed : 0.0; };
+    std::cout << std::format("{} files processed, {} failed, {} threads\n", processed, failures, pool.thread_count());
+    std::cout << std::format("{} glyphs, {} bytes in {:.3f}s\n", total_glyphs, total_bytes, elapsed);
+    std::cout << std::format("{:.1f} files/s, {:.1f} glyphs/s, {:.2f} MB/s\n", rate(processed), rate(total_glyphs), rate(total_bytes / 1e6));
+    return failures ? 1 : 0;
+}
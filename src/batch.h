@@ -0,0 +1,13 @@
+// VT Font Maker
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+class batch {
+public:
+    static int run(const std::vector<std::string>& args);
+};
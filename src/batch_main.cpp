@@ -0,0 +1,10 @@
+// VT Font Maker
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#include "batch.h"
+
+int main(int argc, const char* argv[])
+{
+    return batch::run({argv + 1, argv + argc});
+}
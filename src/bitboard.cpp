@@ -0,0 +1,253 @@
+// VT Font Maker
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#include "bitboard.h"
+
+#include <algorithm>
+#include <array>
+
+namespace {
+
+    uint32_t reverse_bits(uint32_t v)
+    {
+        v = ((v >> 1) & 0x55555555) | ((v & 0x55555555) << 1);
+        v = ((v >> 2) & 0x33333333) | ((v & 0x33333333) << 2);
+        v = ((v >> 4) & 0x0F0F0F0F) | ((v & 0x0F0F0F0F) << 4);
+        v = ((v >> 8) & 0x00FF00FF) | ((v & 0x00FF00FF) << 8);
+        return (v >> 16) | (v << 16);
+    }
+
+    void mirror_bits(std::vector<uint32_t>& rows, const int width)
+    {
+        if (width == 0) return;
+        for (auto& row : rows)
+            row = reverse_bits(row) >> (32 - width);
+    }
+
+    void transpose(std::vector<uint32_t>& rows)
+    {
+        // The standard recursive block swap, which transposes a 32x32 matrix
+        // in five rounds of word operations.
+        auto a = std::array<uint32_t, 32>{};
+        std::copy(rows.begin(), rows.end(), a.begin());
+        auto m = uint32_t{0x0000FFFF};
+        for (auto j = 16; j != 0; j >>= 1, m ^= (m << j)) {
+            for (auto k = 0; k < 32; k = (k + j + 1) & ~j) {
+                const auto t = ((a[k] >> j) ^ a[k + j]) & m;
+                a[k] ^= t << j;
+                a[k + j] ^= t;
+            }
+        }
+        std::copy_n(a.begin(), rows.size(), rows.begin());
+    }
+
+    // A bit-sliced counter, which counts the number of set bits at each bit
+    // position across a series of words, with the count held in four planes.
+    struct bit_counter {
+        uint32_t c0 = 0;
+        uint32_t c1 = 0;
+        uint32_t c2 = 0;
+        uint32_t c3 = 0;
+
+        void add(const uint32_t v)
+        {
+            auto carry = c0 & v;
+            c0 ^= v;
+            const auto carry1 = c1 & carry;
+            c1 ^= carry;
+            carry = c2 & carry1;
+            c2 ^= carry1;
+            c3 |= carry;
+        }
+    };
+
+}  // namespace
+
+// Each row of the board is held in a single word, with the leftmost pixel in
+// the least significant bit, so most transforms only need a few shifts and
+// logical operations per row.
+bitboard::bitboard(const std::vector<int8_t>& pixels, const int stride, const int left, const int top, const int width, const int height)
+    : _width{std::clamp(width, 0, max_size)},
+      _height{std::clamp(height, 0, max_size)},
+      _mask{_width < 32 ? (1u << _width) - 1 : ~0u},
+      _rows(_height)
+{
+    for (auto y = 0; y < _height; y++) {
+        auto row = uint32_t{0};
+        const auto offset = (top + y) * stride + left;
+        for (auto x = 0; x < _width; x++)
+            row |= (pixels[offset + x] ? 1u : 0u) << x;
+        _rows[y] = row;
+    }
+}
+
+void bitboard::store(std::vector<int8_t>& pixels, const int stride, const int left, const int top) const
+{
+    for (auto y = 0; y < _height; y++) {
+        const auto offset = (top + y) * stride + left;
+        for (auto x = 0; x < _width; x++)
+            pixels[offset + x] = (_rows[y] >> x) & 1;
+    }
+}
+
+int bitboard::width() const
+{
+    return _width;
+}
+
+int bitboard::height() const
+{
+    return _height;
+}
+
+void bitboard::invert()
+{
+    for (auto& row : _rows)
+        row = ~row & _mask;
+}
+
+void bitboard::flip_horizontally()
+{
+    mirror_bits(_rows, _width);
+}
+
+void bitboard::flip_vertically()
+{
+    std::reverse(_rows.begin(), _rows.end());
+}
+
+void bitboard::rotate(const int quarter_turns)
+{
+    // Rotation is applied to the largest square in the top left of the
+    // board, since the result needs to fit back in the same area.
+    const auto length = std::min(_width, _height);
+    const auto square_mask = length < 32 ? (1u << length) - 1 : ~0u;
+    auto square = std::vector<uint32_t>(length);
+    for (auto y = 0; y < length; y++)
+        square[y] = _rows[y] & square_mask;
+    switch (quarter_turns & 3) {
+        case 1:
+            transpose(square);
+            mirror_bits(square, length);
+            break;
+        case 2:
+            mirror_bits(square, length);
+            std::reverse(square.begin(), square.end());
+            break;
+        case 3:
+            transpose(square);
+            std::reverse(square.begin(), square.end());
+            break;
+    }
+    for (auto y = 0; y < length; y++)
+        _rows[y] = (_rows[y] & ~square_mask) | square[y];
+}
+
+void bitboard::shift(const int dx, const int dy)
+{
+    // Pixels shifted off one edge wrap around to the opposite edge.
+    if (_width > 0) {
+        const auto n = ((dx % _width) + _width) % _width;
+        if (n) {
+            for (auto& row : _rows)
+                row = ((row << n) | (row >> (_width - n))) & _mask;
+        }
+    }
+    if (_height > 0) {
+        const auto n = ((dy % _height) + _height) % _height;
+        std::rotate(_rows.begin(), _rows.end() - n, _rows.end());
+    }
+}
+
+void bitboard::embolden()
+{
+    // Synthetic bold combines the glyph with a copy shifted one pixel right.
+    for (auto& row : _rows)
+        row = (row | (row << 1)) & _mask;
+}
+
+void bitboard::outline()
+{
+    // The outline is every pixel touching the glyph, including diagonals,
+    // that isn't part of the glyph itself.
+    auto result = std::vector<uint32_t>(_height);
+    for (auto y = 0; y < _height; y++) {
+        auto spread = _row(y - 1) | _row(y) | _row(y + 1);
+        spread |= (spread << 1) | (spread >> 1);
+        result[y] = spread & ~_rows[y] & _mask;
+    }
+    _rows = std::move(result);
+}
+
+void bitboard::erode()
+{
+    // Erosion and dilation use a cross-shaped neighbourhood, which preserves
+    // single pixel diagonals better than a square one would.
+    auto result = std::vector<uint32_t>(_height);
+    for (auto y = 0; y < _height; y++) {
+        const auto row = _rows[y];
+        result[y] = row & (row << 1) & (row >> 1) & _row(y - 1) & _row(y + 1) & _mask;
+    }
+    _rows = std::move(result);
+}
+
+void bitboard::dilate()
+{
+    auto result = std::vector<uint32_t>(_height);
+    for (auto y = 0; y < _height; y++) {
+        const auto row = _rows[y];
+        result[y] = (row | (row << 1) | (row >> 1) | _row(y - 1) | _row(y + 1)) & _mask;
+    }
+    _rows = std::move(result);
+}
+
+void bitboard::thin()
+{
+    // This is the Zhang-Suen thinning algorithm, but evaluated for a whole
+    // row at a time, with the neighbour counts calculated in bit planes.
+    for (auto changed = true; changed;) {
+        changed = false;
+        for (auto pass = 0; pass < 2; pass++) {
+            auto result = _rows;
+            for (auto y = 0; y < _height; y++) {
+                const auto above = _row(y - 1);
+                const auto row = _rows[y];
+                const auto below = _row(y + 1);
+                const auto p2 = above;
+                const auto p3 = above >> 1;
+                const auto p4 = row >> 1;
+                const auto p5 = below >> 1;
+                const auto p6 = below;
+                const auto p7 = below << 1;
+                const auto p8 = row << 1;
+                const auto p9 = above << 1;
+                const auto neighbours = std::array{p2, p3, p4, p5, p6, p7, p8, p9};
+
+                auto count = bit_counter{};
+                auto transitions = bit_counter{};
+                for (auto i = 0; i < 8; i++) {
+                    count.add(neighbours[i]);
+                    transitions.add(~neighbours[i] & neighbours[(i + 1) % 8]);
+                }
+                // Between 2 and 6 neighbours, and exactly one transition.
+                const auto count_ok = (count.c1 | count.c2) & ~count.c3 & ~(count.c0 & count.c1 & count.c2);
+                const auto transitions_ok = transitions.c0 & ~transitions.c1 & ~transitions.c2 & ~transitions.c3;
+                const auto corner_ok = pass == 0
+                    ? ~(p2 & p4 & p6) & ~(p4 & p6 & p8)
+                    : ~(p2 & p4 & p8) & ~(p2 & p6 & p8);
+                const auto removed = row & count_ok & transitions_ok & corner_ok & _mask;
+                if (removed) {
+                    result[y] = row & ~removed;
+                    changed = true;
+                }
+            }
+            _rows = std::move(result);
+        }
+    }
+}
+
+uint32_t bitboard::_row(const int y) const
+{
+    return y >= 0 && y < _height ? _rows[y] : 0;
+}
@@ -0,0 +1,36 @@
+// VT Font Maker
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class bitboard {
+public:
+    bitboard(const std::vector<int8_t>& pixels, const int stride, const int left, const int top, const int width, const int height);
+    void store(std::vector<int8_t>& pixels, const int stride, const int left, const int top) const;
+    int width() const;
+    int height() const;
+    void invert();
+    void flip_horizontally();
+    void flip_vertically();
+    void rotate(const int quarter_turns);
+    void shift(const int dx, const int dy);
+    void embolden();
+    void outline();
+    void erode();
+    void dilate();
+    void thin();
+
+    static constexpr int max_size = 32;
+
+private:
+    uint32_t _row(const int y) const;
+
+    int _width;
+    int _height;
+    uint32_t _mask;
+    std::vector<uint32_t> _rows;
+};
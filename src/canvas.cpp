@@ -4,12 +4,24 @@
 
 #include "canvas.h"
 
+#include "bitboard.h"
 #include "capabilities.h"
+#include "coloring.h"
+#include "dialog.h"
+#include "drawing.h"
+#include "font.h"
 #include "glyphs.h"
 #include "macros.h"
+#include "os.h"
+#include "sixel.h"
 #include "status.h"
 #include "vt.h"
 
+#include <algorithm>
+#include <array>
+#include <initializer_list>
+#include <set>
+
 namespace color {
 
     constexpr auto wallpaper = {0, 37, 45};  // White on LighterBlue
@@ -30,22 +42,75 @@ namespace color {
 
 }  // namespace color
 
+namespace {
+
+    std::vector<uint8_t> encode_delta(const std::vector<int8_t>& before, const std::vector<int8_t>& after)
+    {
+        // The changed pixels are encoded as pairs of run lengths: the number
+        // of unchanged pixels to skip, followed by the number that changed.
+        auto delta = std::vector<uint8_t>{};
+        const auto size = std::min(before.size(), after.size());
+        for (auto i = std::size_t{0}; i < size;) {
+            auto skip = 0;
+            while (i < size && before[i] == after[i] && skip < 255) skip++, i++;
+            auto run = 0;
+            while (i < size && before[i] != after[i] && run < 255) run++, i++;
+            if (run == 0 && i == size) break;
+            delta.push_back(skip);
+            delta.push_back(run);
+        }
+        return delta;
+    }
+
+    void apply_delta(std::vector<int8_t>& pixels, const std::vector<uint8_t>& delta)
+    {
+        auto index = std::size_t{0};
+        for (auto i = std::size_t{0}; i + 1 < delta.size(); i += 2) {
+            index += delta[i];
+            for (auto run = delta[i + 1]; run > 0; run--, index++)
+                pixels[index] ^= 1;
+        }
+    }
+
+    int sequence_length(const std::initializer_list<int> parms)
+    {
+        // The CSI and final character, plus an intermediate, and a separator
+        // between each of the parameters.
+        auto length = static_cast<int>(2 + 2 + parms.size() - 1);
+        for (const auto parm : parms)
+            length += static_cast<int>(std::to_string(parm).length());
+        return length;
+    }
+
+}  // namespace
+
 canvas::canvas(const capabilities& caps, glyph_manager& glyphs, status& status)
     : _caps{caps}, _glyphs{glyphs}, _status{status}
 {
-    _grid_macro = macro_manager::reserve_id();
-    _wallpaper_macro = macro_manager::create([&](auto& macro) {
+    _wallpaper_macro = macro_manager::define([height = caps.height](auto& macro) {
         macro.ls1();
         macro.sgr(color::wallpaper);
-        macro.decfra('@', 2, {}, caps.height - 1, {});
+        macro.decfra('@', 2, {}, height - 1, {});
         macro.ls0();
     });
+    // Any pages beyond those used by the dialogs are available for rendering
+    // the neighbouring glyphs in advance, one for the next glyph, and one for
+    // the previous.
+    for (auto page = caps.page_count; page >= first_spare_page && _prefetched.size() < 2; page--)
+        _prefetched.emplace_back().page = page;
 }
 
 void canvas::render()
 {
-    vtout.decinvm(_wallpaper_macro);
+    macro_manager::invoke(_wallpaper_macro);
     _need_wallpaper = false;
+    // Anything else sharing the wallpaper area needs to be redrawn on top.
+    if (_on_render) _on_render();
+}
+
+void canvas::on_render(const std::function<void()> handler)
+{
+    _on_render = handler;
 }
 
 void canvas::refresh()
@@ -58,6 +123,7 @@ void canvas::refresh()
     _calculate_dimensions();
     _pixels.clear();
     _char_index = {};
+    _clear_history();
     _load_char(_glyphs.first_used(), 0);
 }
 
@@ -115,24 +181,29 @@ void canvas::paste()
 
 void canvas::undo()
 {
-    if (can_undo()) {
-        const auto entry_size = 4 + _cell_width * _cell_height;
-        auto offset = _history.size() - entry_size;
-        const auto focus = coord{_history[offset++], _history[offset++]};
-        const auto selection = size{_history[offset++], _history[offset++]};
-        _select_range(focus, selection);
-        const auto focused_range = _make_range(_focus, _selection);
-        for (auto y = 0; y < _cell_height; y++)
-            for (auto x = 0; x < _cell_width; x++) {
-                auto new_pixel = _history[offset++];
-                auto& pixel = _pixel({y, x});
-                if (pixel != new_pixel) {
-                    pixel = new_pixel;
-                    _render_pixel({y, x}, new_pixel, focused_range);
-                }
-            }
-        _history.resize(_history.size() - entry_size);
-        _history.shrink_to_fit();
+    _commit_history();
+    auto& history = _history[_char_index.value_or(0)];
+    if (!history.undo.empty()) {
+        auto entry = std::move(history.undo.back());
+        history.undo.pop_back();
+        _select_range(entry.focus_before, entry.selection_before);
+        _apply_delta(entry.delta);
+        _apply_batch(entry.serial, true);
+        history.redo.push_back(std::move(entry));
+    }
+}
+
+void canvas::redo()
+{
+    _commit_history();
+    auto& history = _history[_char_index.value_or(0)];
+    if (!history.redo.empty()) {
+        auto entry = std::move(history.redo.back());
+        history.redo.pop_back();
+        _select_range(entry.focus_after, entry.selection_after);
+        _apply_delta(entry.delta);
+        _apply_batch(entry.serial, false);
+        history.undo.push_back(std::move(entry));
     }
 }
 
@@ -143,62 +214,119 @@ bool canvas::can_paste() const
 
 bool canvas::can_undo() const
 {
-    const auto entry_size = 4 + _cell_width * _cell_height;
-    return _history.size() >= entry_size;
+    if (_history_pending && _history_snapshot != _pixels) return true;
+    const auto history = _history.find(_char_index.value_or(0));
+    return history != _history.end() && !history->second.undo.empty();
+}
+
+bool canvas::can_redo() const
+{
+    if (_history_pending && _history_snapshot != _pixels) return false;
+    const auto history = _history.find(_char_index.value_or(0));
+    return history != _history.end() && !history->second.redo.empty();
 }
 
 void canvas::invert()
 {
-    _save_history();
-    const auto focused_range = _make_range(_focus, _selection);
-    _for_each_selection([&](const auto pos, auto& pixel) {
-        pixel ^= 1;
-        _render_pixel(pos, pixel, focused_range);
-    });
+    _transform_selection([](auto& board) { board.invert(); });
 }
 
 void canvas::flip_horizontally()
 {
-    _save_history();
-    const auto focused_range = _make_range(_focus, _selection);
-    const auto target_range = _make_range();
-    const auto origin = target_range.origin();
-    const auto extent = target_range.extent();
-    for (auto y = 0; y <= extent.h; y++) {
-        for (auto x = 0; x < (extent.w + 1) / 2; x++) {
-            const auto pos1 = coord{origin.y + y, origin.x + x};
-            const auto pos2 = coord{origin.y + y, origin.x + extent.w - x};
-            auto& pixel1 = _pixel(pos1);
-            auto& pixel2 = _pixel(pos2);
-            if (pixel1 != pixel2) {
-                std::swap(pixel1, pixel2);
-                _render_pixel(pos1, pixel1, focused_range);
-                _render_pixel(pos2, pixel2, focused_range);
-            }
-        }
-    }
+    _transform_selection([](auto& board) { board.flip_horizontally(); });
 }
 
 void canvas::flip_vertically()
 {
-    _save_history();
-    const auto focused_range = _make_range(_focus, _selection);
-    const auto target_range = _make_range();
-    const auto origin = target_range.origin();
-    const auto extent = target_range.extent();
-    for (auto y = 0; y < (extent.h + 1) / 2; y++) {
-        for (auto x = 0; x <= extent.w; x++) {
-            const auto pos1 = coord{origin.y + y, origin.x + x};
-            const auto pos2 = coord{origin.y + extent.h - y, origin.x + x};
-            auto& pixel1 = _pixel(pos1);
-            auto& pixel2 = _pixel(pos2);
-            if (pixel1 != pixel2) {
-                std::swap(pixel1, pixel2);
-                _render_pixel(pos1, pixel1, focused_range);
-                _render_pixel(pos2, pixel2, focused_range);
-            }
-        }
+    _transform_selection([](auto& board) { board.flip_vertically(); });
+}
+
+void canvas::rotate(const int quarter_turns)
+{
+    _transform_selection([&](auto& board) { board.rotate(quarter_turns); });
+}
+
+void canvas::shift(const int dx, const int dy)
+{
+    _transform_selection([&](auto& board) { board.shift(dx, dy); });
+}
+
+void canvas::embolden()
+{
+    _transform_selection([](auto& board) { board.embolden(); });
+}
+
+void canvas::outline()
+{
+    _transform_selection([](auto& board) { board.outline(); });
+}
+
+void canvas::erode()
+{
+    _transform_selection([](auto& board) { board.erode(); });
+}
+
+void canvas::dilate()
+{
+    _transform_selection([](auto& board) { board.dilate(); });
+}
+
+void canvas::thin()
+{
+    _transform_selection([](auto& board) { board.thin(); });
+}
+
+void canvas::transform_glyphs(const int first_index, const int last_index, const std::function<void(bitboard&)>& transform)
+{
+    _commit_history();
+    flush();
+    const auto changes = _glyphs.transform(first_index, last_index, transform);
+    if (changes.empty()) return;
+    // Every glyph in the batch gets a history entry with the same serial, so
+    // they can all be undone together. The current glyph always gets one,
+    // even if it wasn't changed, so the batch can be undone from here.
+    const auto serial = _history_serial++;
+    const auto current_index = _char_index.value_or(0);
+    auto current_changed = false;
+    for (const auto& change : changes) {
+        auto delta = encode_delta(change.before, change.after);
+        _push_history(change.index, {serial, _focus, _selection, _focus, _selection, std::move(delta)});
+        current_changed = current_changed || change.index == current_index;
     }
+    if (!current_changed)
+        _push_history(current_index, {serial, _focus, _selection, _focus, _selection, {}});
+    _trim_history();
+    _status.dirty(true);
+    if (current_changed) {
+        const auto before = _pixels;
+        _pixels = _glyphs[current_index];
+        _render_changes(before, _make_range({}, {_cell_height - 1, _cell_width - 1}));
+    }
+}
+
+void canvas::draw_line()
+{
+    const auto end = coord{_focus.y + _selection.h, _focus.x + _selection.w};
+    _draw([&](auto& d) { d.line(_focus.x, _focus.y, end.x, end.y); });
+}
+
+void canvas::draw_rectangle()
+{
+    const auto r = _make_range();
+    _draw([&](auto& d) { d.rectangle(r.x.first, r.y.first, r.x.second, r.y.second); });
+}
+
+void canvas::draw_ellipse()
+{
+    const auto r = _make_range();
+    _draw([&](auto& d) { d.ellipse(r.x.first, r.y.first, r.x.second, r.y.second); });
+}
+
+void canvas::flood_fill(const bool eight_way)
+{
+    // The fill is limited to the selection, if there is one.
+    const auto r = _make_range();
+    _draw([&](auto& d) { d.flood_fill(_focus.x, _focus.y, eight_way, r.x.first, r.y.first, r.x.second, r.y.second); });
 }
 
 void canvas::next_char(const bool only_used)
@@ -211,6 +339,11 @@ void canvas::prev_char(const bool only_used)
     _load_char(_char_index.value_or(100), -1, only_used);
 }
 
+void canvas::select_char(const int index)
+{
+    _load_char(index, 0);
+}
+
 void canvas::toggle_double_width()
 {
     _double_width = !_double_width;
@@ -221,7 +354,22 @@ void canvas::toggle_double_width()
 void canvas::toggle_reverse_screen()
 {
     _reversed = !_reversed;
-    _grid_macro_initialized = false;
+    _render();
+}
+
+void canvas::toggle_compact_view()
+{
+    _compact = !_compact;
+    _sixel = false;
+    _calculate_dimensions();
+    _render();
+}
+
+void canvas::toggle_sixel_view()
+{
+    _sixel = !_sixel;
+    _compact = false;
+    _calculate_dimensions();
     _render();
 }
 
@@ -269,60 +417,320 @@ void canvas::process_key(const key key_press)
 
 void canvas::flush()
 {
+    _render_pending_sixel();
     if (_char_index && _dirty) {
         _glyphs[_char_index.value()] = _pixels;
         _dirty = false;
     }
 }
 
+bool canvas::resume_render()
+{
+    if (_pending_rows.empty()) return false;
+    const auto focused_range = _make_range(_focus, _selection);
+    const auto band_height = std::min<int>(_pending_rows.size(), render_band_height);
+    for (auto i = 0; i < band_height; i++)
+        _render_row(_pixels, _pending_rows[i], focused_range, 1, _rendered_rows);
+    _pending_rows.erase(_pending_rows.begin(), _pending_rows.begin() + band_height);
+    return true;
+}
+
+bool canvas::prefetch()
+{
+    // The prefetched pages are only useful once the wallpaper is in place,
+    // since that's not part of the area we copy, and the visible canvas
+    // takes priority if it's not yet complete.
+    // Sixel images aren't something we can rely on DECCRA to copy.
+    if (!_char_index || _need_wallpaper || !_pending_rows.empty() || _sixel) return false;
+    _release_dialog_pages();
+    const auto increments = std::array{+1, -1};
+    for (auto i = std::size_t{0}; i < _prefetched.size(); i++) {
+        const auto index = _find_char(_char_index.value(), increments[i]);
+        if (index == _char_index) continue;
+        const auto pixels = std::vector<int8_t>(_glyphs[index]);
+        auto& entry = _prefetched[i];
+        const auto layout = _grid_layout();
+        if (entry.index == index && entry.layout == layout && entry.focus == _focus && entry.selection == _selection && entry.pixels == pixels)
+            continue;
+        // With page coupling disabled, we can render on another page without
+        // it being displayed. But if a key arrives in the meantime, we drop
+        // what we were doing, so the user isn't kept waiting.
+        entry.index = {};
+        vtout.ppa(entry.page);
+        const auto completed = _render_offscreen(pixels, entry.page);
+        vtout.ppa(1);
+        if (completed)
+            entry = {entry.page, index, layout, _focus, _selection, pixels};
+        return completed;
+    }
+    return false;
+}
+
 void canvas::_render()
+{
+    // A full render supersedes any area still waiting to be redrawn.
+    _sixel_pending = {};
+    _render_grid();
+    if (_sixel) {
+        // The sixel renderer draws the whole canvas as a single image.
+        _pending_rows.clear();
+        _rendered_rows.assign(_cell_height, true);
+        _render_sixel(_pixels, {{_top, _top + _render_height - 1}, {_left, _left + _render_width - 1}});
+        return;
+    }
+    // The rows are rendered in bands, starting with the focused area, and
+    // if a key arrives before we're done, the remaining bands are left for
+    // resume_render to complete when the application is next idle. Anything
+    // that makes the render obsolete simply starts a new one.
+    const auto focused_range = _make_range(_focus, _selection);
+    _pending_rows.clear();
+    _rendered_rows.assign(_cell_height, false);
+    for (auto y = focused_range.y.first; y <= focused_range.y.second; y++)
+        _pending_rows.push_back(y);
+    for (auto y = 0; y < _cell_height; y++)
+        if (y < focused_range.y.first || y > focused_range.y.second)
+            _pending_rows.push_back(y);
+    while (resume_render() && !os::has_input())
+        vtout.flush();
+}
+
+bool canvas::_render_offscreen(const std::vector<int8_t>& pixels, const int page)
 {
     _render_grid();
     const auto focused_range = _make_range(_focus, _selection);
+    auto rendered_rows = std::vector<bool>(_cell_height);
     for (auto y = 0; y < _cell_height; y++) {
+        if (y > 0 && y % render_band_height == 0 && os::has_input())
+            return false;
+        _render_row(pixels, y, focused_range, page, rendered_rows);
+    }
+    return true;
+}
+
+void canvas::_render_row(const std::vector<int8_t>& pixels, const int y, const range& focused_range, const int page, std::vector<bool>& rendered_rows)
+{
+    if (_compact) {
+        // In the compact view, each screen row covers a pair of pixel rows,
+        // which are written out as text, with the focused cells in a
+        // separate run so they can have their own attributes.
+        const auto pair_y = y - y % 2;
+        const auto last_y = std::min(pair_y + 1, _cell_height - 1);
+        if (!rendered_rows[pair_y] && !rendered_rows[last_y]) {
+            const auto row = pair_y / 2;
+            const auto last_col = (_cell_width - 1) / 2;
+            const auto in_focus = focused_range.y.first <= last_y && focused_range.y.second >= pair_y;
+            const auto focus_first = in_focus ? focused_range.x.first / 2 : last_col + 1;
+            const auto focus_last = in_focus ? focused_range.x.second / 2 : last_col;
+            if (focus_first > 0)
+                _render_quadrants(pixels, row, 0, focus_first - 1, false);
+            if (in_focus)
+                _render_quadrants(pixels, row, focus_first, focus_last, true);
+            if (focus_last < last_col)
+                _render_quadrants(pixels, row, focus_last + 1, last_col, false);
+        }
+        rendered_rows[pair_y] = true;
+        rendered_rows[last_y] = true;
+        return;
+    }
+
+    const auto pixel = [&](const int x) { return pixels[y * _cell_width + x]; };
+    const auto for_each_run = [&](auto&& lambda) {
         for (auto x = 0; x < _cell_width; x++) {
             const bool focused = _range_contains(focused_range, {y, x});
-            if (_pixel({y, x})) {
+            if (pixel(x)) {
                 auto x2 = x + 1;
-                while (x2 < _cell_width && _pixel({y, x2}) && focused == _range_contains(focused_range, {y, x2}))
+                while (x2 < _cell_width && pixel(x2) && focused == _range_contains(focused_range, {y, x2}))
                     x2++;
-                _render_pixel_run({y, x}, x2 - x, true, focused);
+                lambda(coord{y, x}, x2 - x, true, focused);
                 x = x2 - 1;
             } else if (focused) {
-                _render_pixel({y, x}, false, true);
+                lambda(coord{y, x}, 1, false, true);
             }
         }
+    };
+
+    // If a row we've already rendered has the same content, it may be cheaper
+    // to copy it than to render the row again.
+    auto run_cost = 0;
+    for_each_run([&](const auto pos, const auto length, const auto, const auto) {
+        const auto r = _screen_range(pos, length);
+        run_cost += sequence_length({r.y.first, r.x.first, r.y.second, r.x.second, 30});
+    });
+    if (const auto source_y = _find_copyable_row(pixels, y, focused_range, rendered_rows)) {
+        const auto source = _screen_range({source_y.value(), 0}, _cell_width);
+        const auto target = _screen_range({y, 0}, _cell_width);
+        const auto copy_cost = sequence_length({source.y.first, source.x.first, source.y.second, source.x.second, page, target.y.first, target.x.first, page});
+        if (copy_cost < run_cost) {
+            vtout.deccra(source.y.first, source.x.first, source.y.second, source.x.second, page, target.y.first, target.x.first, page);
+            rendered_rows[y] = true;
+            return;
+        }
+    }
+    for_each_run([&](const auto pos, const auto length, const auto set, const auto focused) {
+        _render_pixel_run(pos, length, set, focused);
+    });
+    rendered_rows[y] = true;
+}
+
+void canvas::_render_quadrants(const std::vector<int8_t>& pixels, const int row, const int first_col, const int last_col, const bool focused)
+{
+    const auto pixel = [&](const int y, const int x) {
+        return y < _cell_height && x < _cell_width && pixels[y * _cell_width + x];
+    };
+    auto quadrants = std::string{};
+    for (auto col = first_col; col <= last_col; col++) {
+        const auto y = row * 2;
+        const auto x = col * 2;
+        const auto mask = pixel(y, x) | pixel(y, x + 1) << 1 | pixel(y + 1, x) << 2 | pixel(y + 1, x + 1) << 3;
+        quadrants += static_cast<char>(soft_font::quadrant_base + mask);
+    }
+
+    const auto color_pixel = _reversed ? color::light_pixel : color::dark_pixel;
+    const auto color_pixel_focus = _reversed ? color::light_pixel_focus : color::dark_pixel_focus;
+    const auto color_grid = _reversed ? color::light_grid : color::dark_grid;
+    const auto color_grid_focus = _reversed ? color::light_grid_focus : color::dark_grid_focus;
+    const auto fg_color = focused ? color_pixel_focus : color_pixel;
+    const auto bg_color = color_grid[0] + (focused ? color_grid_focus : 0);
+
+    vtout.cup(_top + row, _left + first_col);
+    vtout.sgr({0, 30 + fg_color, 40 + bg_color});
+    vtout.ls1();
+    vtout.write(quadrants);
+    vtout.ls0();
+}
+
+void canvas::_render_sixel(const std::vector<int8_t>& pixels, const range& area)
+{
+    const auto color_pixel = _reversed ? color::light_pixel : color::dark_pixel;
+    const auto color_pixel_focus = _reversed ? color::light_pixel_focus : color::dark_pixel_focus;
+    const auto color_grid = _reversed ? color::light_grid : color::dark_grid;
+    const auto color_grid_focus = _reversed ? color::light_grid_focus : color::dark_grid_focus;
+
+    // The image covers whole cells, so it may include parts of neighbouring
+    // pixels, which is why everything is rendered from the current state.
+    const auto focused_range = _make_range(_focus, _selection);
+    const auto rows = area.y.second - area.y.first + 1;
+    const auto cols = area.x.second - area.x.first + 1;
+    auto image = sixel_image{cols * sixel_cell_width, rows * sixel_cell_height};
+    for (const auto color : {color_pixel, color_pixel_focus, color_grid[0], color_grid[1], color_grid[0] + color_grid_focus, color_grid[1] + color_grid_focus})
+        image.define_color(color, coloring::definition(color));
+    const auto image_top = (area.y.first - _top) * sixel_cell_height;
+    const auto image_left = (area.x.first - _left) * sixel_cell_width;
+    for (auto iy = 0; iy < rows * sixel_cell_height; iy++) {
+        const auto y = (image_top + iy) * 100 / (_pixel_ar * sixel_cell_height);
+        for (auto ix = 0; ix < cols * sixel_cell_width; ix++) {
+            const auto x = (image_left + ix) / (_pixel_width * sixel_cell_width);
+            const auto set = y < _cell_height && x < _cell_width && pixels[y * _cell_width + x];
+            const auto focused = _range_contains(focused_range, {y, x});
+            if (set)
+                image.set(ix, iy, focused ? color_pixel_focus : color_pixel);
+            else
+                image.set(ix, iy, color_grid[(x + y) % 2] + (focused ? color_grid_focus : 0));
+        }
+    }
+    vtout.cup(area.y.first, area.x.first);
+    vtout.dcs(image.str());
+}
+
+void canvas::_render_pending_sixel()
+{
+    if (_sixel_pending) {
+        _render_sixel(_pixels, _sixel_pending.value());
+        _sixel_pending = {};
     }
 }
 
+std::optional<int> canvas::_find_copyable_row(const std::vector<int8_t>& pixels, const int y, const range& focused_range, const std::vector<bool>& rendered_rows) const
+{
+    const auto in_focus = [&](const int row) {
+        return row >= focused_range.y.first && row <= focused_range.y.second;
+    };
+    const auto same_row = [&](const int row1, const int row2) {
+        const auto begin1 = pixels.begin() + row1 * _cell_width;
+        const auto begin2 = pixels.begin() + row2 * _cell_width;
+        return in_focus(row1) == in_focus(row2) && std::equal(begin1, begin1 + _cell_width, begin2);
+    };
+    // When the aspect ratio isn't a whole number, neighbouring pixel rows can
+    // share a screen row, and copying that row would also copy part of the
+    // neighbour. So a shared neighbour must match as well, and must already
+    // have been rendered at the source.
+    const auto shares_screen_row = [&](const int row1, const int row2) {
+        if (row2 < 0 || row2 >= _cell_height) return false;
+        const auto range1 = _screen_range({row1, 0}, 1);
+        const auto range2 = _screen_range({row2, 0}, 1);
+        return range1.y.first <= range2.y.second && range2.y.first <= range1.y.second;
+    };
+    const auto neighbour_matches = [&](const int source_y, const int offset) {
+        const auto shared = shares_screen_row(y, y + offset);
+        if (shared != shares_screen_row(source_y, source_y + offset)) return false;
+        return !shared || (rendered_rows[source_y + offset] && same_row(source_y + offset, y + offset));
+    };
+    // The source row must also be at the same position in the grid pattern,
+    // which implies the same checkerboard parity.
+    const auto rows_per_pattern = static_cast<int>(_pixel_pattern.length()) * 100 / _pixel_ar;
+    for (auto source_y = y % rows_per_pattern; source_y < _cell_height; source_y += rows_per_pattern) {
+        if (source_y == y || !rendered_rows[source_y] || !same_row(source_y, y)) continue;
+        if (neighbour_matches(source_y, -1) && neighbour_matches(source_y, +1))
+            return source_y;
+    }
+    return {};
+}
+
+canvas::range canvas::_screen_range(const coord pos, const int length) const
+{
+    const auto top = pos.y * _pixel_ar / 100 + _top;
+    const auto bottom = ((pos.y + 1) * _pixel_ar - 1) / 100 + _top;
+    const auto left = pos.x * _pixel_width + _left;
+    const auto right = left + (_pixel_width * length) - 1;
+    return {{top, bottom}, {left, right}};
+}
+
 void canvas::_render_grid()
 {
-    if (!_grid_macro_initialized) {
-        _grid_macro_initialized = true;
+    // We keep a separate pair of grid macros for each layout variant, so
+    // toggling back to a layout that's already been used only requires a
+    // single macro invocation.
+    if (_compact || _sixel) {
+        // The compact and sixel views have no grid, since the content of
+        // every cell is rendered in full.
+        if (_need_wallpaper) render();
+        return;
+    }
+    const auto layout = _grid_layout();
+    auto grid_macro = _grid_macros.find(layout);
+    if (grid_macro == _grid_macros.end()) {
+        // Once we've got more variants than the view toggles can produce,
+        // we're likely working with a new font, so the old ones can go.
+        if (_grid_macros.size() >= max_grid_variants) {
+            for (const auto& [unused, ids] : _grid_macros) {
+                macro_manager::release(ids.first);
+                macro_manager::release(ids.second);
+            }
+            _grid_macros.clear();
+        }
 
-        static int grid_macro_inner = macro_manager::reserve_id();
-        macro_manager::create(grid_macro_inner, [&](auto& macro) {
-            const auto color_grid_alt_init = _reversed ? color::light_grid_alt_init : color::dark_grid_alt_init;
-            const auto pattern_height = _pixel_pattern.length();
-            const auto reps = (_cell_width + 1) / 2;
-            macro.decstbm(_top, _top + _render_height - 1);
+        const auto grid_macro_inner = macro_manager::define([=](auto& macro) {
+            const auto color_grid_alt_init = layout.reversed ? color::light_grid_alt_init : color::dark_grid_alt_init;
+            const auto pattern_height = int(layout.pixel_pattern.length());
+            const auto reps = (layout.cell_width + 1) / 2;
+            macro.decstbm(layout.top, layout.top + layout.render_height - 1);
             macro.il(pattern_height);
-            macro.decstbm(_top, _top + pattern_height - 1);
+            macro.decstbm(layout.top, layout.top + pattern_height - 1);
             macro.repeat(reps, [&](auto& macro2) {
-                macro2.decic(_pixel_width * 2);
+                macro2.decic(layout.pixel_width * 2);
                 for (auto i = 0; i < pattern_height; i++)
-                    macro2.decfra(_pixel_pattern[i], i + 1, {}, i + 1, _pixel_width * 2);
-                macro2.deccara({}, {}, pattern_height, _pixel_width, color_grid_alt_init);
+                    macro2.decfra(layout.pixel_pattern[i], i + 1, {}, i + 1, layout.pixel_width * 2);
+                macro2.deccara({}, {}, pattern_height, layout.pixel_width, color_grid_alt_init);
             });
         });
 
-        macro_manager::create(_grid_macro, [&](auto& macro) {
-            const auto color_grid_init = _reversed ? color::light_grid_init : color::dark_grid_init;
-            const auto pattern_height = _pixel_pattern.length();
-            const auto reps = (_render_height + pattern_height - 1) / pattern_height;
+        const auto grid_macro_outer = macro_manager::define([=](auto& macro) {
+            const auto color_grid_init = layout.reversed ? color::light_grid_init : color::dark_grid_init;
+            const auto pattern_height = layout.pixel_pattern.length();
+            const auto reps = (layout.render_height + pattern_height - 1) / pattern_height;
             macro.sgr(color_grid_init);
             macro.ls1();
-            macro.decslrm(_left, _left + _render_width - 1);
+            macro.decslrm(layout.left, layout.left + layout.render_width - 1);
             macro.repeat(reps, [&](auto& macro2) {
                 macro2.decinvm(grid_macro_inner);
             });
@@ -330,12 +738,46 @@ void canvas::_render_grid()
             macro.decslrm();
             macro.ls0();
         });
+
+        grid_macro = _grid_macros.emplace(layout, std::pair{grid_macro_outer, grid_macro_inner}).first;
     }
     if (_need_wallpaper) render();
-    vtout.decinvm(_grid_macro);
+    macro_manager::invoke(grid_macro->second.first);
 }
 
-void canvas::_load_char(const int start_index, const int increment, const bool only_used)
+bool canvas::_render_prefetched(const int index)
+{
+    if (_need_wallpaper) return false;
+    _release_dialog_pages();
+    for (const auto& entry : _prefetched) {
+        if (entry.index != index) continue;
+        if (entry.layout != _grid_layout() || entry.focus != _focus || entry.selection != _selection || entry.pixels != _pixels)
+            return false;
+        vtout.deccra(_top, _left, _top + _render_height - 1, _left + _render_width - 1, entry.page, _top, _left, 1);
+        _pending_rows.clear();
+        _rendered_rows.assign(_cell_height, true);
+        return true;
+    }
+    return false;
+}
+
+void canvas::_release_dialog_pages()
+{
+    // The dialogs take pages from the bottom up, so if enough of them have
+    // been nested to reach the pages we're prefetching into, the contents of
+    // those pages can't be trusted, and they can't be used again. The pages
+    // at the end of the list are the lowest, so they're the first to go.
+    std::erase_if(_prefetched, [](const auto& entry) {
+        return entry.page <= dialog::highest_page();
+    });
+}
+
+canvas::grid_layout canvas::_grid_layout() const
+{
+    return {_pixel_pattern, _pixel_width, _cell_width, _top, _left, _render_height, _render_width, _reversed, _compact, _sixel};
+}
+
+int canvas::_find_char(const int start_index, const int increment, const bool only_used) const
 {
     const auto size = _glyphs.size();
     const auto min_index = size == 96 ? 0 : 1;
@@ -345,12 +787,19 @@ void canvas::_load_char(const int start_index, const int increment, const bool o
         index = std::clamp(index + increment, min_index, max_index);
         if (index == min_index || index == max_index) break;
     } while (only_used && !_glyphs[index].used());
+    return index;
+}
+
+void canvas::_load_char(const int start_index, const int increment, const bool only_used)
+{
+    const auto index = _find_char(start_index, increment, only_used);
     if (index != _char_index) {
+        _commit_history();
         flush();
-        _clear_history();
         _pixels = _glyphs[index];
         _char_index = index;
-        _render();
+        if (!_render_prefetched(index))
+            _render();
         _status.index(_char_index.value());
     }
 }
@@ -364,6 +813,10 @@ void canvas::_select_range(const coord origin, const size extent)
     if (_focus != coord{new_y, new_x} || _selection != size{new_h, new_w}) {
         const auto new_range = _make_range({new_y, new_x}, {new_h, new_w});
         const auto old_range = _make_range(_focus, _selection);
+        // The focus is updated first, since some renderers redraw whole cells
+        // from the current state.
+        _focus = {new_y, new_x};
+        _selection = {new_h, new_w};
         for (auto y = 0; y < _cell_height; y++) {
             const auto y_inside_old = y >= old_range.y.first && y <= old_range.y.second;
             const auto y_inside_new = y >= new_range.y.first && y <= new_range.y.second;
@@ -374,8 +827,6 @@ void canvas::_select_range(const coord origin, const size extent)
                     _render_pixel({y, x}, _pixel({y, x}), inside_new);
             }
         }
-        _focus = {new_y, new_x};
-        _selection = {new_h, new_w};
     }
 }
 
@@ -410,10 +861,27 @@ void canvas::_render_pixel(const coord pos, const bool set, const bool focused)
 
 void canvas::_render_pixel_run(const coord pos, const int length, const bool set, const bool focused)
 {
-    const auto top = pos.y * _pixel_ar / 100 + _top;
-    const auto bottom = ((pos.y + 1) * _pixel_ar - 1) / 100 + _top;
-    const auto left = pos.x * _pixel_width + _left;
-    const auto right = left + (_pixel_width * length) - 1;
+    if (_compact) {
+        // The quadrant glyphs are generated from the pixel buffer, so the
+        // affected cells are simply rewritten with their current content.
+        _render_quadrants(_pixels, pos.y / 2, pos.x / 2, (pos.x + length - 1) / 2, focused);
+        return;
+    }
+    if (_sixel) {
+        // Similarly for sixel, we redraw the cells covering the run, but
+        // since each image has a fixed overhead, the affected areas are
+        // merged and rendered as one image when the operation is flushed.
+        const auto r = _screen_range(pos, length);
+        if (_sixel_pending) {
+            auto& pending = _sixel_pending.value();
+            pending.y = {std::min(pending.y.first, r.y.first), std::max(pending.y.second, r.y.second)};
+            pending.x = {std::min(pending.x.first, r.x.first), std::max(pending.x.second, r.x.second)};
+        } else {
+            _sixel_pending = r;
+        }
+        return;
+    }
+    const auto r = _screen_range(pos, length);
 
     const auto color_pixel = _reversed ? color::light_pixel : color::dark_pixel;
     const auto color_pixel_focus = _reversed ? color::light_pixel_focus : color::dark_pixel_focus;
@@ -424,7 +892,7 @@ void canvas::_render_pixel_run(const coord pos, const int length, const bool set
 
     auto attr = set ? fg_color : bg_color;
     attr += (pos.y % 2 ? 40 : 30);
-    vtout.deccara(top, left, bottom, right, {attr});
+    vtout.deccara(r.y.first, r.x.first, r.y.second, r.x.second, {attr});
 }
 
 void canvas::_toggle_pixel(const coord pos)
@@ -447,6 +915,122 @@ void canvas::_fill_selection(const int fill)
     });
 }
 
+void canvas::_draw(const std::function<void(drawing&)>& tool)
+{
+    _save_history();
+    const auto before = _pixels;
+    auto d = drawing{_pixels, _cell_width, _cell_height};
+    tool(d);
+    _render_changes(before, _make_range({}, {_cell_height - 1, _cell_width - 1}));
+}
+
+void canvas::_transform_selection(const std::function<void(bitboard&)>& transform)
+{
+    _save_history();
+    const auto area = _make_range();
+    const auto origin = area.origin();
+    const auto extent = area.extent();
+    auto board = bitboard{_pixels, _cell_width, origin.x, origin.y, extent.w + 1, extent.h + 1};
+    transform(board);
+    const auto before = _pixels;
+    board.store(_pixels, _cell_width, origin.x, origin.y);
+    _render_changes(before, area);
+}
+
+void canvas::_render_changes(const std::vector<int8_t>& before, const range& area)
+{
+    // The changed pixels are merged into rectangles, so large changes can be
+    // rendered with a handful of DECCARA sequences. Set pixels are merged in
+    // runs along the row, but cleared pixels can only be merged down a single
+    // column, since the grid color alternates across the row. Matching runs
+    // on consecutive rows are combined into a single rectangle.
+    struct run {
+        int x1;
+        int x2;
+        bool set;
+        bool focused;
+        int y1 = 0;
+    };
+    const auto focused_range = _make_range(_focus, _selection);
+    auto open_runs = std::vector<run>{};
+    for (auto y = area.y.first; y <= area.y.second + 1; y++) {
+        auto next_runs = std::vector<run>{};
+        for (auto x = area.x.first; y <= area.y.second && x <= area.x.second;) {
+            const auto index = y * _cell_width + x;
+            if (_pixels[index] == before[index]) {
+                x++;
+                continue;
+            }
+            const auto set = _pixels[index] != 0;
+            const auto focused = _range_contains(focused_range, {y, x});
+            auto x2 = x;
+            while (set && x2 < area.x.second) {
+                const auto next_index = index + x2 - x + 1;
+                if (!_pixels[next_index] || _pixels[next_index] == before[next_index]) break;
+                if (_range_contains(focused_range, {y, x2 + 1}) != focused) break;
+                x2++;
+            }
+            auto new_run = run{x, x2, set, focused, y};
+            const auto continued = std::find_if(open_runs.begin(), open_runs.end(), [&](const auto& r) {
+                return r.x1 == new_run.x1 && r.x2 == new_run.x2 && r.set == new_run.set && r.focused == new_run.focused;
+            });
+            if (continued != open_runs.end()) {
+                new_run.y1 = continued->y1;
+                open_runs.erase(continued);
+            }
+            next_runs.push_back(new_run);
+            x = x2 + 1;
+        }
+        // Anything that didn't continue onto this row is complete.
+        for (const auto& r : open_runs)
+            _render_rectangle({{r.y1, y - 1}, {r.x1, r.x2}}, r.set, r.focused);
+        open_runs = std::move(next_runs);
+    }
+}
+
+void canvas::_render_rectangle(const range& r, const bool set, const bool focused)
+{
+    if (_compact || _sixel) {
+        for (auto y = r.y.first; y <= r.y.second; y++)
+            _render_pixel_run({y, r.x.first}, r.x.second - r.x.first + 1, set, focused);
+        return;
+    }
+
+    const auto color_pixel = _reversed ? color::light_pixel : color::dark_pixel;
+    const auto color_pixel_focus = _reversed ? color::light_pixel_focus : color::dark_pixel_focus;
+    const auto color_grid = _reversed ? color::light_grid : color::dark_grid;
+    const auto color_grid_focus = _reversed ? color::light_grid_focus : color::dark_grid_focus;
+    const auto attr_for_row = [&](const int y) {
+        const auto fg_color = focused ? color_pixel_focus : color_pixel;
+        const auto bg_color = color_grid[(r.x.first + y) % 2] + (focused ? color_grid_focus : 0);
+        return (set ? fg_color : bg_color) + (y % 2 ? 40 : 30);
+    };
+
+    // Even pixel rows are rendered with the foreground attribute and odd rows
+    // with the background, so a rectangle covering multiple rows can set
+    // both at once. But where a screen row is shared with a pixel row outside
+    // the rectangle, only the attribute of the row inside can be changed.
+    const auto length = r.x.second - r.x.first + 1;
+    const auto first = _screen_range({r.y.first, r.x.first}, length);
+    const auto left = first.x.first;
+    const auto right = first.x.second;
+    auto top = first.y.first;
+    auto bottom = _screen_range({r.y.second, r.x.first}, length).y.second;
+    if (r.y.first > 0 && _screen_range({r.y.first - 1, 0}, 1).y.second == top) {
+        vtout.deccara(top, left, top, right, {attr_for_row(r.y.first)});
+        top++;
+    }
+    if (r.y.second < _cell_height - 1 && _screen_range({r.y.second + 1, 0}, 1).y.first == bottom && bottom >= top) {
+        vtout.deccara(bottom, left, bottom, right, {attr_for_row(r.y.second)});
+        bottom--;
+    }
+    if (top > bottom) return;
+    if (r.y.first == r.y.second)
+        vtout.deccara(top, left, bottom, right, {attr_for_row(r.y.first)});
+    else
+        vtout.deccara(top, left, bottom, right, {attr_for_row(r.y.first), attr_for_row(r.y.first + 1)});
+}
+
 int8_t& canvas::_pixel(const coord pos)
 {
     return _pixels[pos.y * _cell_width + pos.x];
@@ -480,26 +1064,167 @@ void canvas::_calculate_dimensions()
     _pixel_width = (_double_width ? 2 : 1) * (scale_down ? 1 : 2);
     _render_height = (_cell_height * _pixel_ar + 99) / 100;
     _render_width = _cell_width * _pixel_width;
+    if (_compact) {
+        // The compact view shows a 2x2 block of pixels in every cell.
+        _render_height = (_cell_height + 1) / 2;
+        _render_width = (_cell_width + 1) / 2;
+    }
     _top = std::max((_caps.height - _render_height) / 2 + 1, 1);
     _left = std::max((_caps.width - _render_width) / 2 + 1, 1);
-    _grid_macro_initialized = false;
     _need_wallpaper = true;
 }
 
 void canvas::_save_history()
 {
+    // We only take a snapshot of the glyph here. The delta is calculated
+    // when the edit is committed, which is at the start of the next edit,
+    // or when undoing, redoing, or moving to another glyph.
+    _commit_history();
+    _dirty = true;
+    _status.dirty(true);
+    _history_snapshot = _pixels;
+    _history_focus = _focus;
+    _history_selection = _selection;
+    _history_pending = true;
+}
+
+void canvas::_commit_history()
+{
+    if (!_history_pending) return;
+    _history_pending = false;
+    auto delta = encode_delta(_history_snapshot, _pixels);
+    if (delta.empty()) return;
+    auto entry = history_entry{_history_serial++, _history_focus, _history_selection, _focus, _selection, std::move(delta)};
+    _push_history(_char_index.value_or(0), std::move(entry));
+    _trim_history();
+}
+
+void canvas::_push_history(const int index, history_entry entry)
+{
+    // A new edit makes anything that was undone unreachable.
+    _discard_redo(index);
+    _history_bytes += entry.memory_used();
+    _history[index].undo.push_back(std::move(entry));
+}
+
+void canvas::_discard_redo(const int index)
+{
+    // If a batch was undone along with the entries being discarded, it can't
+    // be redone in the other glyphs either, and nor can anything that was
+    // undone in those glyphs before the batch, since that depends on the
+    // batch being redone first. Those glyphs may in turn share other batches,
+    // so we keep going until there's nothing more to discard.
+    auto serials = std::vector<int>{};
+    const auto discard_until = [&](std::deque<history_entry>& redo, const std::deque<history_entry>::iterator end) {
+        for (auto i = redo.begin(); i != end; i++) {
+            _history_bytes -= i->memory_used();
+            serials.push_back(i->serial);
+        }
+        redo.erase(redo.begin(), end);
+    };
+    auto& redo = _history[index].redo;
+    discard_until(redo, redo.end());
+    for (auto discarded = !serials.empty(); discarded;) {
+        discarded = false;
+        for (auto& [other_index, history] : _history) {
+            const auto last = std::find_if(history.redo.rbegin(), history.redo.rend(), [&](const auto& entry) {
+                return std::find(serials.begin(), serials.end(), entry.serial) != serials.end();
+            });
+            if (last == history.redo.rend()) continue;
+            discard_until(history.redo, last.base());
+            discarded = true;
+        }
+    }
+}
+
+void canvas::_trim_history()
+{
+    // When we're over the memory limit, we discard the oldest entries, no
+    // matter which glyph they belong to. Entries from a batch share the same
+    // serial, so they're discarded together.
+    while (_history_bytes > max_history_bytes) {
+        auto oldest = std::optional<int>{};
+        for (const auto& [index, history] : _history) {
+            if (history.undo.empty()) continue;
+            if (!oldest || history.undo.front().serial < oldest.value())
+                oldest = history.undo.front().serial;
+        }
+        if (!oldest) break;
+        for (auto& [index, history] : _history) {
+            if (history.undo.empty() || history.undo.front().serial != oldest) continue;
+            _history_bytes -= history.undo.front().memory_used();
+            history.undo.pop_front();
+        }
+    }
+}
+
+void canvas::_apply_batch(const int serial, const bool undoing)
+{
+    // The other glyphs changed in the same batch aren't on screen, so their
+    // deltas are applied directly to the glyph manager. If any of them were
+    // changed by a later batch, that batch has to be undone first, in every
+    // glyph it touched, and those glyphs may have later batches of their
+    // own. So we collect every batch that depends on this one, and undo them
+    // all as a whole, newest first. Redoing works the same way, in the other
+    // direction, with anything undone after this batch being redone first.
+    const auto current_index = _char_index.value_or(0);
+    auto serials = std::set<int>{serial};
+    for (auto added = true; added;) {
+        added = false;
+        for (auto& [index, history] : _history) {
+            if (index == current_index) continue;
+            const auto& from = undoing ? history.undo : history.redo;
+            const auto first = std::find_if(from.begin(), from.end(), [&](const auto& entry) {
+                return serials.contains(entry.serial);
+            });
+            for (auto i = first; i != from.end(); i++)
+                added = serials.insert(i->serial).second || added;
+        }
+    }
+    auto changed = std::map<int, std::vector<int8_t>>{};
+    const auto apply = [&](const int batch) {
+        for (auto& [index, history] : _history) {
+            if (index == current_index) continue;
+            auto& from = undoing ? history.undo : history.redo;
+            auto& to = undoing ? history.redo : history.undo;
+            if (from.empty() || from.back().serial != batch) continue;
+            if (!changed.contains(index))
+                changed[index] = std::vector<int8_t>(_glyphs[index]);
+            apply_delta(changed[index], from.back().delta);
+            to.push_back(std::move(from.back()));
+            from.pop_back();
+        }
+    };
+    if (undoing)
+        std::for_each(serials.rbegin(), serials.rend(), apply);
+    else
+        std::for_each(serials.begin(), serials.end(), apply);
+    for (const auto& [index, pixels] : changed)
+        _glyphs[index] = pixels;
+}
+
+void canvas::_apply_delta(const std::vector<uint8_t>& delta)
+{
+    // The delta is a sequence of unchanged and changed run lengths, so the
+    // cost of applying it is proportional to the number of changed pixels.
     _dirty = true;
     _status.dirty(true);
-    _history.push_back(_focus.y);
-    _history.push_back(_focus.x);
-    _history.push_back(_selection.h);
-    _history.push_back(_selection.w);
-    _history.insert(_history.end(), _pixels.begin(), _pixels.end());
+    const auto focused_range = _make_range(_focus, _selection);
+    auto index = 0;
+    for (auto i = std::size_t{0}; i + 1 < delta.size(); i += 2) {
+        index += delta[i];
+        for (auto run = delta[i + 1]; run > 0; run--, index++) {
+            auto& pixel = _pixels[index];
+            pixel ^= 1;
+            _render_pixel({index / _cell_width, index % _cell_width}, pixel, focused_range);
+        }
+    }
 }
 
 void canvas::_clear_history()
 {
     _dirty = false;
     _history.clear();
-    _history.shrink_to_fit();
+    _history_pending = false;
+    _history_bytes = 0;
 }
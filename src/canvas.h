@@ -6,12 +6,19 @@
 
 #include "keyboard.h"
 
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
 #include <optional>
 #include <string>
 #include <tuple>
 #include <vector>
 
+class bitboard;
 class capabilities;
+class drawing;
 class glyph_manager;
 class status;
 
@@ -19,6 +26,7 @@ class canvas {
 public:
     canvas(const capabilities& caps, glyph_manager& glyphs, status& status);
     void render();
+    void on_render(const std::function<void()> handler);
     void refresh();
     void select_all();
     void cut_selection();
@@ -26,17 +34,36 @@ public:
     void delete_selection();
     void paste();
     void undo();
+    void redo();
     bool can_paste() const;
     bool can_undo() const;
+    bool can_redo() const;
     void invert();
     void flip_horizontally();
     void flip_vertically();
+    void rotate(const int quarter_turns);
+    void shift(const int dx, const int dy);
+    void embolden();
+    void outline();
+    void erode();
+    void dilate();
+    void thin();
+    void draw_line();
+    void draw_rectangle();
+    void draw_ellipse();
+    void flood_fill(const bool eight_way);
+    void transform_glyphs(const int first_index, const int last_index, const std::function<void(bitboard&)>& transform);
     void next_char(const bool only_used = false);
     void prev_char(const bool only_used = false);
+    void select_char(const int index);
     void toggle_double_width();
     void toggle_reverse_screen();
+    void toggle_compact_view();
+    void toggle_sixel_view();
     void process_key(const key key_press);
     void flush();
+    bool resume_render();
+    bool prefetch();
 
 private:
     struct coord {
@@ -55,9 +82,64 @@ private:
         coord origin() const { return {y.first, x.first}; }
         size extent() const { return {y.second - y.first, x.second - x.first}; }
     };
+    struct grid_layout {
+        std::string pixel_pattern;
+        int pixel_width = 0;
+        int cell_width = 0;
+        int top = 0;
+        int left = 0;
+        int render_height = 0;
+        int render_width = 0;
+        bool reversed = false;
+        bool compact = false;
+        bool sixel = false;
+        auto operator<=>(const grid_layout&) const = default;
+    };
+
+    struct prefetched_glyph {
+        int page = 0;
+        std::optional<int> index;
+        grid_layout layout;
+        coord focus;
+        size selection;
+        std::vector<int8_t> pixels;
+    };
+
+    struct history_entry {
+        int serial = 0;
+        coord focus_before;
+        size selection_before;
+        coord focus_after;
+        size selection_after;
+        std::vector<uint8_t> delta;
+        std::size_t memory_used() const { return sizeof(history_entry) + delta.capacity(); }
+    };
+    struct glyph_history {
+        std::deque<history_entry> undo;
+        std::deque<history_entry> redo;
+    };
+
+    static constexpr int max_grid_variants = 4;
+    static constexpr std::size_t max_history_bytes = 1024 * 1024;
+    static constexpr int first_spare_page = 4;
+    static constexpr int render_band_height = 4;
+    // The sixel renderer assumes the VT340 cell size.
+    static constexpr int sixel_cell_width = 10;
+    static constexpr int sixel_cell_height = 20;
 
     void _render();
+    bool _render_offscreen(const std::vector<int8_t>& pixels, const int page);
+    void _render_row(const std::vector<int8_t>& pixels, const int y, const range& focused_range, const int page, std::vector<bool>& rendered_rows);
+    void _render_quadrants(const std::vector<int8_t>& pixels, const int row, const int first_col, const int last_col, const bool focused);
+    void _render_sixel(const std::vector<int8_t>& pixels, const range& area);
+    void _render_pending_sixel();
+    std::optional<int> _find_copyable_row(const std::vector<int8_t>& pixels, const int y, const range& focused_range, const std::vector<bool>& rendered_rows) const;
+    range _screen_range(const coord pos, const int length) const;
     void _render_grid();
+    bool _render_prefetched(const int index);
+    void _release_dialog_pages();
+    grid_layout _grid_layout() const;
+    int _find_char(const int start_index, const int increment, const bool only_used = false) const;
     void _load_char(const int start_index, const int increment, const bool only_used = false);
     void _select_range(const coord origin, const size extent = {0, 0});
     range _make_range() const;
@@ -68,9 +150,19 @@ private:
     void _render_pixel_run(const coord pos, const int length, const bool set, const bool focused);
     void _toggle_pixel(const coord pos);
     void _fill_selection(const int fill);
+    void _draw(const std::function<void(drawing&)>& tool);
+    void _transform_selection(const std::function<void(bitboard&)>& transform);
+    void _render_changes(const std::vector<int8_t>& before, const range& area);
+    void _render_rectangle(const range& r, const bool set, const bool focused);
     int8_t& _pixel(const coord pos);
     void _calculate_dimensions();
     void _save_history();
+    void _commit_history();
+    void _push_history(const int index, history_entry entry);
+    void _discard_redo(const int index);
+    void _trim_history();
+    void _apply_batch(const int serial, const bool undoing);
+    void _apply_delta(const std::vector<uint8_t>& delta);
     void _clear_history();
 
     template <typename T>
@@ -85,9 +177,10 @@ private:
     const capabilities& _caps;
     glyph_manager& _glyphs;
     status& _status;
-    bool _grid_macro_initialized = false;
-    int _grid_macro;
+    std::map<grid_layout, std::pair<int, int>> _grid_macros;
+    std::vector<prefetched_glyph> _prefetched;
     int _wallpaper_macro;
+    std::function<void()> _on_render;
     int _cell_height = 16;
     int _cell_width = 10;
     int _render_height = 20;
@@ -101,11 +194,22 @@ private:
     int _left = 1;
     bool _double_width = false;
     bool _reversed = false;
+    bool _compact = false;
+    bool _sixel = false;
+    std::optional<range> _sixel_pending;
     bool _need_wallpaper = true;
     coord _focus;
     size _selection;
     std::vector<int8_t> _pixels;
-    std::vector<int8_t> _history;
+    std::vector<int> _pending_rows;
+    std::vector<bool> _rendered_rows;
+    std::map<int, glyph_history> _history;
+    std::vector<int8_t> _history_snapshot;
+    coord _history_focus;
+    size _history_selection;
+    bool _history_pending = false;
+    std::size_t _history_bytes = 0;
+    int _history_serial = 0;
     std::vector<int8_t> _clipboard;
     size _clipboard_size;
     std::optional<int> _char_index;
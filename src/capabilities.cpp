@@ -5,14 +5,39 @@
 #include "capabilities.h"
 
 #include "os.h"
+#include "reports.h"
 #include "vt.h"
 
-#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
 
 using namespace std::string_literals;
 
-capabilities::capabilities()
+namespace {
+
+    constexpr auto report_timeout = std::chrono::seconds{5};
+
+    std::filesystem::path cache_filepath()
+    {
+        auto path = os::cache_path();
+        if (!path.empty()) path.append("capabilities");
+        return path;
+    }
+
+}  // namespace
+
+capabilities::capabilities(const bool reprobe)
 {
+    // The static capabilities are cached, keyed on the DA report. We can't
+    // tell which terminal this is until DA has been answered, but it's most
+    // likely one we've seen before, so if there's anything in the cache, the
+    // static probes are left out. Otherwise they're included in the initial
+    // burst. Either way, startup normally only costs one round trip.
+    auto probed = reprobe || !std::filesystem::exists(cache_filepath());
     // Save the cursor position.
     vtout.decsc();
     // Request 7-bit C1 controls from the terminal.
@@ -20,25 +45,33 @@ capabilities::capabilities()
     // Determine the screen size.
     vtout.cup(999, 999);
     vtout.dsr(6);
-    const auto size = _query(R"(\x1B\[(\d+);(\d+)R)", false);
-    if (!size.empty()) {
-        height = std::stoi(size[1]);
-        width = std::stoi(size[2]);
-    }
     // Retrieve the device attributes report.
-    _query_device_attributes();
-    // Retrieve the keyboard type.
-    _query_keyboard_type();
+    vtout.da();
+    // Save the scrollback and page coupling modes. These are session state,
+    // so they're queried every time.
+    vtout.decrqm('?', 112);
+    vtout.decrqm('?', 64);
     // Disable scrollback and page coupling.
-    _original_decrpl = query_mode(112);
-    _original_decpccm = query_mode(64);
     vtout.rm('?', {112, 64});
-    // Try and move to page 3 and check the result with DECXCPR.
-    vtout.ppa(3);
-    vtout.dsr('?', 6);
-    const auto page = _query(R"(\x1B\[\??\d+;\d+(?:;(\d+))?R)", true);
-    if (!page.empty() && page[1].matched)
-        has_pages = std::stoi(page[1]) == 3;
+    if (probed) _probe_static();
+    // Retrieve the current color table, which is also session state.
+    vtout.decctr(2);
+    // The reports are matched up as they arrive in _read_reports, and a final
+    // DA query acts as the sentinel, since it's guaranteed to be answered
+    // last.
+    vtout.da();
+    _read_reports(2);
+    // If this turns out to be a terminal that isn't in the cache, it costs
+    // a second round trip to probe the static capabilities. And if there was
+    // no DA report at all, there's no point in continuing.
+    const auto responsive = !_device_attributes_report.empty();
+    if (responsive && !probed && !_load_cache()) {
+        _probe_static();
+        vtout.da();
+        _read_reports(1);
+        probed = true;
+    }
+    if (responsive && probed) _save_cache();
     // Restore the cursor position.
     vtout.decrc();
     // Make sure we've returned to page 1.
@@ -61,112 +94,152 @@ capabilities::~capabilities()
     vtout.flush();
 }
 
-std::optional<bool> capabilities::query_mode(const int mode) const
+void capabilities::_probe_static()
+{
+    // Retrieve the keyboard type.
+    vtout.dsr('?', 26);
+    // Clear any existing macros, and retrieve the available macro space.
+    vtout.decdmac({}, 1, {});
+    vtout.dsr('?', 62);
+    // Try and move past the last page and check the result with DECXCPR.
+    // The terminal clamps the move, so that gives us the page count.
+    vtout.ppa(99);
+    vtout.dsr('?', 6);
+}
+
+void capabilities::_read_reports(const int da_count)
+{
+    using namespace std::chrono;
+    vtout.flush();
+    // If the terminal doesn't respond in time, we give up, and anything that
+    // hasn't been reported by then is assumed to be unsupported.
+    const auto deadline = steady_clock::now() + report_timeout;
+    auto parser = report_parser{};
+    for (auto da_received = 0; da_received < da_count;) {
+        const auto remaining = duration_cast<milliseconds>(deadline - steady_clock::now());
+        const auto ch = os::getch(std::max<int>(remaining.count(), 0));
+        if (ch < 0) break;
+        const auto parsed = parser.parse(ch);
+        if (!parsed) continue;
+        const auto& report = parsed.value();
+        using type = report::type;
+        if (report.is(type::csi, '?', "", 'c')) {
+            // The first DA report is the one we asked for, and any later
+            // reports are the sentinel marking the end of a burst.
+            if (_device_attributes_report.empty()) {
+                _device_attributes_report = report.str();
+                _device_attributes(report);
+            }
+            da_received++;
+        } else if (report.final == 'R' && report.kind == type::csi) {
+            // The first position report is the CPR with the screen size, and
+            // the second is the DECXCPR with the last page number.
+            if (!_size_received) {
+                height = report.parm(0);
+                width = report.parm(1);
+                _size_received = true;
+            } else if (report.parms.size() >= 3) {
+                page_count = report.parm(2);
+                has_pages = page_count >= 3;
+            }
+        } else if (report.is(type::csi, '?', "", 'n') && report.parm(0) == 27) {
+            _keyboard_type(report);
+        } else if (report.is(type::csi, '?', "$", 'y')) {
+            _mode(report);
+        } else if (report.is(type::csi, 0, "*", '{')) {
+            // The macro space is reported in 16-byte units.
+            macro_space = report.parm(0) * 16;
+        } else if (report.is(type::dcs, 0, "$", 's') && report.parm(0) == 2) {
+            color_table = report.data;
+        }
+    }
+}
+
+void capabilities::_device_attributes(const report& report)
 {
-    vtout.decrqm('?', mode);
-    const auto report = _query(R"(\x1B\[\?(\d+);(\d+)\$y)", true);
-    if (!report.empty()) {
-        const auto returned_mode = std::stoi(report[1]);
-        const auto status = std::stoi(report[2]);
-        if (returned_mode == mode) {
-            if (status == 1) return true;
-            if (status == 2) return false;
+    // The first parameter indicates the terminal conformance level.
+    const auto level = report.parm(0);
+    // Level 4+ conformance implies support for features 28 and 32.
+    if (level >= 64) {
+        has_rectangle_ops = true;
+        has_macros = true;
+    }
+    // The remaining parameters indicate additional feature extensions.
+    for (auto i = std::size_t{1}; i < report.parms.size(); i++) {
+        switch (report.parms[i]) {
+            case 4: has_sixel = true; break;
+            case 7: has_soft_fonts = true; break;
+            case 21: has_horizontal_scrolling = true; break;
+            case 22: has_color = true; break;
+            case 28: has_rectangle_ops = true; break;
+            case 32: has_macros = true; break;
         }
     }
-    return {};
 }
 
-std::string capabilities::query_color_table() const
+void capabilities::_keyboard_type(const report& report)
 {
-    vtout.decctr(2);
-    const auto report = _query(R"(\x1BP2\$s(.*)\x1B\\)", true);
-    if (!report.empty())
-        return report[1];
-    else
-        return {};
+    // Likely a PC layout if type is LK443 (2) or PCXAL (5). If no type is
+    // reported, it's likely an older terminal with an LK201.
+    const auto type = report.parm(3);
+    has_pc_keyboard = type == 2 || type == 5;
 }
 
-void capabilities::_query_keyboard_type()
+void capabilities::_mode(const report& report)
 {
-    vtout.dsr('?', 26);
-    const auto report = _query(R"(\x1B\[\?27;\d+;\d+;(\d+)n)", true);
-    if (!report.empty()) {
-        // Likely a PC layout if type is LK443 (2) or PCXAL (5).
-        const auto type = std::stoi(report[1]);
-        has_pc_keyboard = type == 2 || type == 5;
-    } else {
-        // If no type found, likely an older terminal with LK201.
-        has_pc_keyboard = false;
-    }
+    const auto mode = report.parm(0);
+    const auto status = report.parm(1);
+    auto value = std::optional<bool>{};
+    if (status == 1) value = true;
+    if (status == 2) value = false;
+    if (mode == 112) _original_decrpl = value;
+    if (mode == 64) _original_decpccm = value;
 }
 
-void capabilities::_query_device_attributes()
+bool capabilities::_load_cache()
 {
-    vtout.da();
-    // The Reflection Desktop terminal sometimes uses comma separators
-    // instead of semicolons in their DA report, so we allow for either.
-    const auto report = _query(R"(\x1B\[\?(\d+)([;,\d]*)c)", false);
-    if (!report.empty()) {
-        // The first parameter indicates the terminal conformance level.
-        const auto level = std::stoi(report[1]);
-        // Level 4+ conformance implies support for features 28 and 32.
-        if (level >= 64) {
-            has_rectangle_ops = true;
-            has_macros = true;
+    auto file = std::ifstream{cache_filepath()};
+    auto line = std::string{};
+    while (std::getline(file, line)) {
+        auto fields = std::unordered_map<std::string, std::string>{};
+        auto field_stream = std::istringstream{line};
+        auto field = std::string{};
+        while (field_stream >> field) {
+            const auto equals = field.find('=');
+            if (equals != std::string::npos)
+                fields[field.substr(0, equals)] = field.substr(equals + 1);
         }
-        // The remaining parameters indicate additional feature extensions.
-        const auto features = report[2].str();
-        const auto digits = std::regex(R"(\d+)");
-        auto it = std::sregex_iterator(features.begin(), features.end(), digits);
-        while (it != std::sregex_iterator()) {
-            const auto feature = std::stoi(it->str());
-            switch (feature) {
-                case 7: has_soft_fonts = true; break;
-                case 21: has_horizontal_scrolling = true; break;
-                case 22: has_color = true; break;
-                case 28: has_rectangle_ops = true; break;
-                case 32: has_macros = true; break;
-            }
-            it++;
+        // Entries without a page count predate the current probe format.
+        if (fields["da"] == _device_attributes_report && fields.contains("page_count")) {
+            page_count = std::atoi(fields["page_count"].c_str());
+            has_pages = page_count >= 3;
+            has_pc_keyboard = fields["pc_keyboard"] == "1";
+            macro_space = std::atoi(fields["macro_space"].c_str());
+            return true;
         }
     }
+    return false;
 }
 
-std::smatch capabilities::_query(const char* pattern, const bool may_not_work)
+void capabilities::_save_cache() const
 {
-    auto final_char = pattern[strlen(pattern) - 1];
-    if (may_not_work) {
-        // If we're uncertain this query is supported, we'll send an extra DA
-        // or DSR-CPR query to make sure that we get some kind of response.
-        if (final_char == 'R') {
-            final_char = 'c';
-            vtout.da();
-        } else {
-            final_char = 'R';
-            vtout.dsr(6);
-        }
-    }
-    vtout.flush();
-    // This needs to be static so the returned smatch can reference it.
-    static auto response = std::string{};
-    response.clear();
-    auto last_escape = 0;
-    for (;;) {
-        const auto ch = os::getch();
-        // Ignore XON, XOFF
-        if (ch == '\021' || ch == '\023')
-            continue;
-        // If we've sent an extra query, the last escape should be the
-        // start of that response, which we'll ultimately drop.
-        if (may_not_work && ch == '\033')
-            last_escape = response.length();
-        response += ch;
-        if (ch == final_char) break;
-    }
-    // Drop the extra response if one was requested.
-    if (may_not_work)
-        response = response.substr(0, last_escape);
-    auto match = std::smatch{};
-    std::regex_match(response, match, std::regex(pattern));
-    return match;
+    const auto filepath = cache_filepath();
+    if (filepath.empty()) return;
+    // Preserve the entries for any other terminals in the cache.
+    auto contents = std::string{};
+    auto file = std::ifstream{filepath};
+    auto line = std::string{};
+    while (std::getline(file, line))
+        if (!line.starts_with("da=" + _device_attributes_report + " "))
+            contents += line + "\n";
+    file.close();
+    contents += "da=" + _device_attributes_report;
+    contents += " page_count=" + std::to_string(page_count);
+    contents += " pc_keyboard="s + (has_pc_keyboard ? "1" : "0");
+    contents += " macro_space=" + std::to_string(macro_space);
+    contents += "\n";
+    auto error = std::error_code{};
+    std::filesystem::create_directories(filepath.parent_path(), error);
+    auto out_file = std::ofstream{filepath, std::ios::binary};
+    out_file << contents;
 }
@@ -5,15 +5,14 @@
 #pragma once
 
 #include <optional>
-#include <regex>
 #include <string>
 
+class report;
+
 class capabilities {
 public:
-    capabilities();
+    capabilities(const bool reprobe = false);
     ~capabilities();
-    std::optional<bool> query_mode(const int mode) const;
-    std::string query_color_table() const;
 
     int width = 80;
     int height = 24;
@@ -23,13 +22,23 @@ public:
     bool has_rectangle_ops = false;
     bool has_macros = false;
     bool has_pages = false;
+    bool has_sixel = false;
+    int page_count = 1;
     bool has_pc_keyboard = false;
+    int macro_space = 0;
+    std::string color_table;
 
 private:
-    void _query_device_attributes();
-    void _query_keyboard_type();
-    static std::smatch _query(const char* pattern, const bool may_not_work);
+    void _probe_static();
+    void _read_reports(const int da_count);
+    bool _load_cache();
+    void _save_cache() const;
+    void _device_attributes(const report& report);
+    void _keyboard_type(const report& report);
+    void _mode(const report& report);
 
+    std::string _device_attributes_report;
+    bool _size_received = false;
     std::optional<bool> _original_decrpl;
     std::optional<bool> _original_decpccm;
 };
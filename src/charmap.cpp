@@ -0,0 +1,32 @@
+// VT Font Maker
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#include "charmap.h"
+
+#include "dialog.h"
+#include "glyphs.h"
+#include "preview.h"
+
+character_map::character_map(glyph_manager& glyphs, preview_font& font)
+    : _glyphs{glyphs}, _font{font}
+{
+}
+
+std::optional<int> character_map::show(const int index)
+{
+    // The grid is drawn with the preview font, so that has to be up to date
+    // before the dialog is shown, regardless of any pending debounce.
+    _font.load();
+
+    const auto size = _glyphs.size();
+    auto dlg = dialog{L"Character Map"};
+    auto& grid = dlg.add_glyph_grid(size == 96 ? 0 : 1, size == 96 ? 95 : 94);
+    auto& buttons = dlg.add_group(dialog::alignment::right);
+    buttons.add_button(L"Edit", 1, true);
+    buttons.add_button(L"Cancel", 2);
+    grid.selection(index);
+    if (dlg.show() == 1)
+        return grid.selection();
+    return {};
+}
@@ -0,0 +1,20 @@
+// VT Font Maker
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#pragma once
+
+#include <optional>
+
+class glyph_manager;
+class preview_font;
+
+class character_map {
+public:
+    character_map(glyph_manager& glyphs, preview_font& font);
+    std::optional<int> show(const int index);
+
+private:
+    glyph_manager& _glyphs;
+    preview_font& _font;
+};
@@ -7,23 +7,37 @@
 #include "capabilities.h"
 #include "vt.h"
 
+#include <array>
+
+namespace {
+
+    using namespace std::string_view_literals;
+
+    constexpr auto palette = std::array{
+        "0;2;0;0;0"sv,         // Black
+        "1;2;8;8;8"sv,         // DarkGray
+        "2;2;19;30;50"sv,      // DarkerBlue
+        "3;2;23;34;54"sv,      // DarkBlue
+        "4;2;56;67;87"sv,      // LightBlue
+        "5;2;58;70;90"sv,      // LighterBlue
+        "6;2;75;75;75"sv,      // LightGray
+        "7;2;80;80;80"sv,      // White
+        "8;2;15;24;40"sv,      // DarkestBlue
+        "14;2;95;95;95"sv,     // BrightWhite
+        "15;2;100;100;100"sv,  // BrightestWhite
+    };
+
+}  // namespace
+
 coloring::coloring(const capabilities& caps)
 {
     // Save the current color table.
-    _color_table = caps.query_color_table();
+    _color_table = caps.color_table;
     // Set the desired color table entries.
-    vtout.dcs("2$p"
-              "0;2;0;0;0/"           // Black
-              "1;2;8;8;8/"           // DarkGray
-              "2;2;19;30;50/"        // DarkerBlue
-              "3;2;23;34;54/"        // DarkBlue
-              "4;2;56;67;87/"        // LightBlue
-              "5;2;58;70;90/"        // LighterBlue
-              "6;2;75;75;75/"        // LightGray
-              "7;2;80;80;80/"        // White
-              "8;2;15;24;40/"        // DarkestBlue
-              "14;2;95;95;95/"       // BrightWhite
-              "15;2;100;100;100/");  // BrightestWhite
+    auto color_table = std::string{"2$p"};
+    for (const auto entry : palette)
+        color_table.append(entry).append("/");
+    vtout.dcs(color_table);
 }
 
 coloring::~coloring()
@@ -46,3 +60,14 @@ coloring::~coloring()
                   "15;2;100;100;100");
     }
 }
+
+std::string_view coloring::definition(const int index)
+{
+    // Returns the color space and components of a palette entry, in the
+    // format used by both DECRSTS and sixel color introducers.
+    const auto prefix = std::to_string(index) + ";";
+    for (const auto entry : palette)
+        if (entry.starts_with(prefix))
+            return entry.substr(prefix.length());
+    return {};
+}
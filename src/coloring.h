@@ -5,6 +5,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 
 class capabilities;
 
@@ -12,6 +13,7 @@ class coloring {
 public:
     coloring(const capabilities& caps);
     ~coloring();
+    static std::string_view definition(const int index);
 
 private:
     std::string _color_table;
@@ -0,0 +1,103 @@
+// VT Font Maker
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#include "delta.h"
+
+#include "glyphs.h"
+
+#include <utility>
+
+namespace {
+
+    bool same_layout(const glyph_manager& a, const glyph_manager& b)
+    {
+        // An incremental update is only possible if the terminal would load
+        // the new font into the same character set with the same cell size.
+        const auto& a_params = a.params();
+        const auto& b_params = b.params();
+        return a.id() == b.id() &&
+            a.size() == b.size() &&
+            a.cell_width() == b.cell_width() &&
+            a.cell_height() == b.cell_height() &&
+            a_params.pfn() == b_params.pfn() &&
+            a_params.pcmw() == b_params.pcmw() &&
+            a_params.pss() == b_params.pss() &&
+            a_params.pu() == b_params.pu() &&
+            a_params.pcmh() == b_params.pcmh();
+    }
+
+}  // namespace
+
+font_delta::font_delta(glyph_manager& old_glyphs, glyph_manager& new_glyphs)
+    : _new_glyphs{new_glyphs}
+{
+    const auto size = new_glyphs.size();
+    const auto min_index = size == 96 ? 0 : 1;
+    const auto max_index = size == 96 ? 95 : 94;
+
+    _incremental = same_layout(old_glyphs, new_glyphs);
+    if (!_incremental) {
+        // Otherwise the whole font has to be sent, erasing the old one.
+        _changed_count = max_index - min_index + 1;
+        _sequences.push_back(_sequence(min_index, max_index, 0));
+        return;
+    }
+
+    // The glyphs are compared by their pixels rather than their sixels, so
+    // differences in the encoding alone don't count as a change.
+    auto runs = std::vector<std::pair<int, int>>{};
+    for (auto index = min_index; index <= max_index; index++) {
+        if (std::vector<int8_t>(new_glyphs[index]) == std::vector<int8_t>(old_glyphs[index])) continue;
+        _changed_count++;
+        if (!runs.empty() && runs.back().second == index - 1)
+            runs.back().second = index;
+        else
+            runs.emplace_back(index, index);
+    }
+
+    // Each run starts a new DECDLD at its own Pcn offset, unless resending
+    // the unchanged glyphs in the gap would take fewer bytes than the
+    // introducer, parameters, and terminator of a separate sequence.
+    auto ranges = std::vector<std::pair<int, int>>{};
+    for (const auto& run : runs) {
+        if (!ranges.empty()) {
+            auto& last = ranges.back();
+            const auto merged = _sequence(last.first, run.second, 1).length();
+            const auto separate = _sequence(last.first, last.second, 1).length() + _sequence(run.first, run.second, 1).length();
+            if (merged <= separate) {
+                last.second = run.second;
+                continue;
+            }
+        }
+        ranges.push_back(run);
+    }
+    for (const auto& [first_index, last_index] : ranges)
+        _sequences.push_back(_sequence(first_index, last_index, 1));
+}
+
+bool font_delta::incremental() const
+{
+    return _incremental;
+}
+
+int font_delta::changed_count() const
+{
+    return _changed_count;
+}
+
+const std::vector<std::string>& font_delta::sequences() const
+{
+    return _sequences;
+}
+
+std::string font_delta::_sequence(const int first_index, const int last_index, const int erase) const
+{
+    // The sequences use the same control format as the new font file, with
+    // 7-bit controls if that can't be determined.
+    const auto c1_8bit = _new_glyphs.c1_controls().value_or(false);
+    const auto introducer = c1_8bit ? "\x90" : "\x1BP";
+    const auto terminator = c1_8bit ? "\x9C" : "\x1B\\";
+    const auto buffer = _new_glyphs.params().pfn().value_or(0);
+    return introducer + _new_glyphs.decdld(first_index, last_index, _new_glyphs.id(), buffer, erase) + terminator;
+}
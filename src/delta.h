@@ -0,0 +1,26 @@
+// VT Font Maker
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+class glyph_manager;
+
+class font_delta {
+public:
+    font_delta(glyph_manager& old_glyphs, glyph_manager& new_glyphs);
+    bool incremental() const;
+    int changed_count() const;
+    const std::vector<std::string>& sequences() const;
+
+private:
+    std::string _sequence(const int first_index, const int last_index, const int erase) const;
+
+    const glyph_manager& _new_glyphs;
+    bool _incremental = false;
+    int _changed_count = 0;
+    std::vector<std::string> _sequences;
+};
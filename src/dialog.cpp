@@ -8,6 +8,7 @@
 #include "macros.h"
 #include "vt.h"
 
+#include <algorithm>
 #include <chrono>
 #include <numeric>
 
@@ -32,7 +33,7 @@ namespace {
 
         int draw_frame()
         {
-            static int frame_macro = macro_manager::create([](auto& macro) {
+            static int frame_macro = macro_manager::define([](auto& macro) {
                 macro.sgr(color::basic);
                 macro.decfra(' ', {}, {}, {}, {});
 
@@ -91,6 +92,7 @@ namespace {
 
     static int screen_height = 24;
     static int screen_width = 80;
+    static int highest_page_used = 1;
 
 }  // namespace
 
@@ -707,6 +709,112 @@ void dropdown_control::_move_to(const int index)
     }
 }
 
+glyph_grid_control::glyph_grid_control(const int first_index, const int last_index, layout& parent)
+    : control{parent, true}, _first_index{first_index}, _last_index{last_index}, _selection{first_index}
+{
+}
+
+int glyph_grid_control::selection() const
+{
+    return _selection;
+}
+
+void glyph_grid_control::selection(const int index)
+{
+    _selection = std::clamp(index, _first_index, _last_index);
+    _dirty();
+    _notify_change();
+}
+
+int glyph_grid_control::_min_height() const
+{
+    return rows;
+}
+
+int glyph_grid_control::_min_width() const
+{
+    return columns * 2 + 1;
+}
+
+void glyph_grid_control::_instantiate(borders& borders)
+{
+    // The glyphs are laid out like a code table, with index 0 representing
+    // the space character, and are expected to be designated into G3.
+    vtout.sgr(color::input);
+    vtout.decfra(' ', _top, _left, _bottom, _right);
+    vtout.ls3();
+    for (auto row = 0; row < rows; row++) {
+        vtout.cup(_top + row, _left + 1);
+        for (auto column = 0; column < columns; column++) {
+            const auto index = row * columns + column;
+            if (index >= _first_index && index <= _last_index)
+                vtout.write(static_cast<char>(0x20 + index));
+            else
+                vtout.cuf();
+            if (column + 1 < columns) vtout.cuf();
+        }
+    }
+    vtout.ls0();
+    borders.all(_top, _left, _bottom, _right, '[', ']');
+}
+
+void glyph_grid_control::_redraw(const bool focused)
+{
+    vtout.deccara(_top, _left, _bottom, _right, color::input);
+    if (focused) _render_selection(true);
+}
+
+void glyph_grid_control::_focus(const bool focused)
+{
+    _render_selection(focused);
+    if (focused) _notify_change();
+}
+
+bool glyph_grid_control::_handle_key(const key key_press)
+{
+    switch (key_press) {
+        case key::left:
+            _move_to(_selection - 1);
+            return true;
+        case key::right:
+            _move_to(_selection + 1);
+            return true;
+        case key::up:
+            _move_to(_selection - columns);
+            return true;
+        case key::down:
+            _move_to(_selection + columns);
+            return true;
+        case key::home:
+            _move_to(_first_index);
+            return true;
+        case key::end:
+            _move_to(_last_index);
+            return true;
+        default:
+            return control::_handle_key(key_press);
+    }
+}
+
+void glyph_grid_control::_move_to(const int index)
+{
+    const auto new_selection = std::clamp(index, _first_index, _last_index);
+    if (_selection != new_selection) {
+        _render_selection(false);
+        _selection = new_selection;
+        _render_selection(true);
+        _notify_change();
+    }
+}
+
+void glyph_grid_control::_render_selection(const bool selected)
+{
+    const auto y = _top + _selection / columns;
+    const auto x = _left + 1 + (_selection % columns) * 2;
+    const auto attrs = selected ? color::selected : color::unselected;
+    vtout.deccara(y, x, y, x, attrs);
+}
+
 button_control::button_control(const std::wstring_view label, const int id, layout& parent)
     : control{parent, true}, _label{label}, _id{id}
 {
@@ -781,6 +889,11 @@ dropdown_control& layout::add_dropdown(const std::wstring_view label, const std:
     return control;
 }
 
+glyph_grid_control& layout::add_glyph_grid(const int first_index, const int last_index)
+{
+    return _add_control<glyph_grid_control>(first_index, last_index, *this);
+}
+
 button_control& layout::add_button(const std::wstring_view label, const int id, const bool is_default)
 {
     auto& button = _add_control<button_control>(label, id, *this);
@@ -922,10 +1035,17 @@ void dialog::initialize(const capabilities& caps)
     screen_height = caps.height;
     screen_width = caps.width;
 
-    // Force macro instantiation.
+    // Reserve the frame macro, although it won't be uploaded until needed.
     macros::draw_frame();
 }
 
+int dialog::highest_page()
+{
+    // Nested dialogs each save the screen on a page of their own, so this is
+    // the highest page that has been overwritten by any of them so far.
+    return highest_page_used;
+}
+
 dialog::dialog(const std::wstring_view title)
     : layout{*this, *this}, _title{title}
 {
@@ -941,11 +1061,12 @@ int dialog::show()
 
     static int page = 1;
     page++;
+    highest_page_used = std::max(highest_page_used, page);
 
     vtout.deccra(_top, _left, {}, {}, 1, _top, _left, page);
     vtout.decstbm(_top, _bottom);
     vtout.decslrm(_left, _right);
-    vtout.decinvm(macros::draw_frame());
+    macro_manager::invoke(macros::draw_frame());
 
     vtout.cup({}, int(screen_width - _title.length()) / 2 + 2 - _left);
     vtout.write(_title);
@@ -166,6 +166,30 @@ private:
     int _selection = 0;
 };
 
+class glyph_grid_control : public control {
+public:
+    glyph_grid_control(const int first_index, const int last_index, layout& parent);
+    int selection() const;
+    void selection(const int index);
+
+private:
+    virtual int _min_height() const;
+    virtual int _min_width() const;
+    virtual void _instantiate(borders& borders);
+    virtual void _redraw(const bool focused);
+    virtual void _focus(const bool focused);
+    virtual bool _handle_key(const key key_press);
+
+    void _move_to(const int index);
+    void _render_selection(const bool selected);
+
+    static constexpr int columns = 16;
+    static constexpr int rows = 6;
+    int _first_index;
+    int _last_index;
+    int _selection;
+};
+
 class button_control : public control {
 public:
     button_control(const std::wstring_view label, const int id, layout& parent);
@@ -201,6 +225,7 @@ public:
     input_control& add_input(const std::wstring_view label, const int width);
     list_control& add_list(const std::initializer_list<std::wstring_view> headers, const std::initializer_list<int> widths, const int height);
     dropdown_control& add_dropdown(const std::wstring_view label, const std::vector<std::wstring>& options);
+    glyph_grid_control& add_glyph_grid(const int first_index, const int last_index);
     button_control& add_button(const std::wstring_view label, const int id, const bool is_default = false);
     layout& add_group(const alignment halign = alignment::left);
     void add_gap();
@@ -239,6 +264,7 @@ private:
 class dialog : public layout {
 public:
     static void initialize(const capabilities& caps);
+    static int highest_page();
 
     dialog(const std::wstring_view title);
     int show();
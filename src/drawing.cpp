@@ -0,0 +1,129 @@
+// VT Font Maker
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#include "drawing.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <utility>
+
+drawing::drawing(std::vector<int8_t>& pixels, const int width, const int height)
+    : _pixels{pixels}, _width{width}, _height{height}
+{
+}
+
+void drawing::line(const int x0, const int y0, const int x1, const int y1)
+{
+    // Bresenham's algorithm, with the error term covering both axes, so it
+    // works for lines in any direction.
+    const auto dx = std::abs(x1 - x0);
+    const auto dy = -std::abs(y1 - y0);
+    const auto sx = x0 < x1 ? 1 : -1;
+    const auto sy = y0 < y1 ? 1 : -1;
+    auto err = dx + dy;
+    for (auto x = x0, y = y0;;) {
+        _plot(x, y);
+        if (x == x1 && y == y1) break;
+        const auto e2 = 2 * err;
+        if (e2 >= dy) {
+            err += dy;
+            x += sx;
+        }
+        if (e2 <= dx) {
+            err += dx;
+            y += sy;
+        }
+    }
+}
+
+void drawing::rectangle(const int left, const int top, const int right, const int bottom)
+{
+    line(left, top, right, top);
+    line(right, top, right, bottom);
+    line(right, bottom, left, bottom);
+    line(left, bottom, left, top);
+}
+
+void drawing::ellipse(const int left, const int top, const int right, const int bottom)
+{
+    // This plots an ellipse inscribed in the given rectangle, using Alois
+    // Zingl's variant of the midpoint algorithm, which also handles even
+    // diameters, where the center falls between two pixels.
+    auto x0 = std::min(left, right);
+    auto x1 = std::max(left, right);
+    auto y0 = std::min(top, bottom);
+    auto y1 = std::max(top, bottom);
+    long long a = x1 - x0;
+    long long b = y1 - y0;
+    long long b1 = b & 1;
+    long long dx = 4 * (1 - a) * b * b;
+    long long dy = 4 * (b1 + 1) * a * a;
+    long long err = dx + dy + b1 * a * a;
+    y0 += (b + 1) / 2;
+    y1 = y0 - b1;
+    a *= 8 * a;
+    b1 = 8 * b * b;
+    do {
+        _plot(x1, y0);
+        _plot(x0, y0);
+        _plot(x0, y1);
+        _plot(x1, y1);
+        const auto e2 = 2 * err;
+        if (e2 <= dy) {
+            y0++;
+            y1--;
+            err += dy += a;
+        }
+        if (e2 >= dx || 2 * err > dy) {
+            x0++;
+            x1--;
+            err += dx += b1;
+        }
+    } while (x0 <= x1);
+    // Flat ellipses can stop too early, so we need to finish the tips.
+    while (y0 - y1 < b) {
+        _plot(x0 - 1, y0);
+        _plot(x1 + 1, y0++);
+        _plot(x0 - 1, y1);
+        _plot(x1 + 1, y1--);
+    }
+}
+
+void drawing::flood_fill(const int x, const int y, const bool eight_way, const int left, const int top, const int right, const int bottom)
+{
+    // This is a scanline fill: each seed is expanded into a horizontal span,
+    // and only the start of each matching span on the rows above and below
+    // is pushed as a new seed. The filled area toggles the pixels that match
+    // the seed, so it can be used to erase as well as to fill.
+    const auto target = _pixels[y * _width + x];
+    const auto matches = [&](const int px, const int py) {
+        return _pixels[py * _width + px] == target;
+    };
+    auto seeds = std::vector<std::pair<int, int>>{{x, y}};
+    while (!seeds.empty()) {
+        const auto [seed_x, seed_y] = seeds.back();
+        seeds.pop_back();
+        if (!matches(seed_x, seed_y)) continue;
+        auto x1 = seed_x;
+        auto x2 = seed_x;
+        while (x1 > left && matches(x1 - 1, seed_y)) x1--;
+        while (x2 < right && matches(x2 + 1, seed_y)) x2++;
+        std::fill_n(&_pixels[seed_y * _width + x1], x2 - x1 + 1, !target);
+        const auto scan_left = eight_way ? std::max(x1 - 1, left) : x1;
+        const auto scan_right = eight_way ? std::min(x2 + 1, right) : x2;
+        for (const auto scan_y : {seed_y - 1, seed_y + 1}) {
+            if (scan_y < top || scan_y > bottom) continue;
+            for (auto scan_x = scan_left; scan_x <= scan_right; scan_x++) {
+                if (matches(scan_x, scan_y) && (scan_x == scan_left || !matches(scan_x - 1, scan_y)))
+                    seeds.emplace_back(scan_x, scan_y);
+            }
+        }
+    }
+}
+
+void drawing::_plot(const int x, const int y)
+{
+    if (x >= 0 && x < _width && y >= 0 && y < _height)
+        _pixels[y * _width + x] = 1;
+}
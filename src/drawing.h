@@ -0,0 +1,24 @@
+// VT Font Maker
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class drawing {
+public:
+    drawing(std::vector<int8_t>& pixels, const int width, const int height);
+    void line(const int x0, const int y0, const int x1, const int y1);
+    void rectangle(const int left, const int top, const int right, const int bottom);
+    void ellipse(const int left, const int top, const int right, const int bottom);
+    void flood_fill(const int x, const int y, const bool eight_way, const int left, const int top, const int right, const int bottom);
+
+private:
+    void _plot(const int x, const int y);
+
+    std::vector<int8_t>& _pixels;
+    int _width;
+    int _height;
+};
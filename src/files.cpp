@@ -0,0 +1,32 @@
+// VT Font Maker
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#include "files.h"
+
+// This is kept separate from the os class, since it's needed by the core
+// library, which has to build without any of the terminal handling.
+
+#ifdef _WIN32
+
+#include <io.h>
+
+void files::sync(std::FILE* file)
+{
+    std::fflush(file);
+    _commit(_fileno(file));
+}
+
+#endif
+
+#ifdef __linux__
+
+#include <unistd.h>
+
+void files::sync(std::FILE* file)
+{
+    std::fflush(file);
+    fdatasync(fileno(file));
+}
+
+#endif
@@ -0,0 +1,12 @@
+// VT Font Maker
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#pragma once
+
+#include <cstdio>
+
+class files {
+public:
+    static void sync(std::FILE* file);
+};
@@ -6,6 +6,8 @@
 
 #include "vt.h"
 
+#include <string>
+
 constexpr auto font_10x16 = R"(0;2;1;10;0;2;16;0{ @
 NNNNNNNNNN/??????????/??????????;
 ~~~~~~~~~~/~~~~~~~~~~/NNNNNNNNNN;;;;
@@ -39,6 +41,38 @@ BFKG~~~~~?/_??_~~~^N?/BBFEEEAAA@;
 @@@@@@@@@@/??????????/??????????
 )";
 
+namespace {
+
+    std::string quadrant_glyphs()
+    {
+        // The quadrant glyphs are loaded into a free range of the soft font,
+        // starting at quadrant_base, with one glyph for each combination of
+        // the four quadrants. Bit 0 is the top left quadrant, bit 1 the top
+        // right, bit 2 the bottom left, and bit 3 the bottom right.
+        const auto pcn = soft_font::quadrant_base - 0x20;
+        auto font_data = "0;" + std::to_string(pcn) + ";1;10;0;2;16;0{ @";
+        for (auto mask = 0; mask < 16; mask++) {
+            if (mask > 0) font_data += ';';
+            for (auto band = 0; band < 3; band++) {
+                if (band > 0) font_data += '/';
+                for (auto x = 0; x < 10; x++) {
+                    const auto right = x >= 5;
+                    auto sixel = 0;
+                    for (auto bit = 0; bit < 6; bit++) {
+                        const auto y = band * 6 + bit;
+                        const auto bottom = y >= 8;
+                        if (y < 16 && (mask & (1 << (bottom * 2 + right))))
+                            sixel |= 1 << bit;
+                    }
+                    font_data += static_cast<char>('?' + sixel);
+                }
+            }
+        }
+        return font_data;
+    }
+
+}  // namespace
+
 soft_font::soft_font()
 {
     auto font_data = std::string{font_10x16};
@@ -46,6 +80,7 @@ soft_font::soft_font()
     // containing newlines, so we need to strip those out first.
     std::erase(font_data, '\n');
     vtout.dcs(font_data);
+    vtout.dcs(quadrant_glyphs());
     // Designate the soft font as G1.
     vtout.scs(1, " @");
 }
@@ -8,4 +8,10 @@ class soft_font {
 public:
     soft_font();
     ~soft_font();
+
+    static constexpr char quadrant_base = 'G';
+    // The font being edited is loaded into the second font buffer, with a
+    // Dscs that won't clash with the application font.
+    static constexpr int preview_buffer = 2;
+    static constexpr auto preview_id = " A";
 };
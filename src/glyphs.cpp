@@ -4,8 +4,13 @@
 
 #include "glyphs.h"
 
+#include "bitboard.h"
+
+#include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <regex>
+#include <thread>
 
 namespace {
 
@@ -35,6 +40,37 @@ namespace {
         return ch >= '@' && ch <= '~';
     }
 
+    std::string read_file(const std::filesystem::path& path)
+    {
+        auto file = std::ifstream{path, std::ios::binary};
+        auto error = std::error_code{};
+        const auto size = std::filesystem::file_size(path, error);
+        if (error) return {};
+        auto contents = std::string(size, '\0');
+        file.read(contents.data(), size);
+        return contents;
+    }
+
+    // This is the limit for following a chain of symlinks when saving, so
+    // a loop can't keep us going forever.
+    constexpr auto max_symlinks = 40;
+
+    std::filesystem::path autosave_path_for(const std::filesystem::path& path)
+    {
+        auto autosave_path = path;
+        autosave_path += ".autosave";
+        return autosave_path;
+    }
+
+    bool is_newer(const std::filesystem::path& path, const std::filesystem::path& than_path)
+    {
+        auto error = std::error_code{};
+        const auto time = std::filesystem::last_write_time(path, error);
+        if (error) return false;
+        const auto than_time = std::filesystem::last_write_time(than_path, error);
+        return error || time >= than_time;
+    }
+
 }  // namespace
 
 glyph::glyph(const std::string_view sixels)
@@ -121,8 +157,9 @@ glyph_reference::operator std::vector<int8_t>() const
 bool glyph_reference::used() const
 {
     const auto internal_index = _index - _manager._first_index;
-    if (internal_index >= 0 && internal_index < _manager._glyphs.size())
-        return _manager._glyphs[internal_index].used();
+    const auto& glyphs = *_manager._glyphs;
+    if (internal_index >= 0 && internal_index < std::ssize(glyphs))
+        return glyphs[internal_index]->used();
     else
         return false;
 }
@@ -139,6 +176,10 @@ void glyph_manager::clear()
 
 void glyph_manager::clear(const std::vector<int>& params, const std::string_view id)
 {
+    _path.clear();
+    _journal.close();
+    _recovered = false;
+    _modified_since_snapshot = false;
     c1_controls(false);
     _prefix.clear();
     _suffix.clear();
@@ -146,19 +187,147 @@ void glyph_manager::clear(const std::vector<int>& params, const std::string_view
     _sixel_prefix.clear();
     _sixel_suffix.clear();
     _parms = std::make_unique<parameters>(params);
-    _glyphs.clear();
+    _glyphs = std::make_shared<glyph_table>();
+    _revision++;
     _size = _parms->pcss().value_or(0) == 1 ? 96 : 94;
     _first_index = _parms->pcn().value_or(_size == 96 ? 0 : 1);
     std::tie(_cell_width, _cell_height, _pixel_aspect_ratio) = _detect_dimensions();
 }
 
-bool glyph_manager::load(const std::filesystem::path& path)
+bool glyph_manager::load(const std::filesystem::path& path, const bool recover)
+{
+    // Without recovery, we just want the content of the file, and nothing
+    // is journalled, so the font can be examined without side effects.
+    if (!recover) {
+        if (!_parse(read_file(path)))
+            return false;
+        _path.clear();
+        _journal.close();
+        _recovered = false;
+        _modified_since_snapshot = false;
+        return true;
+    }
+    // If there's an autosave from a session that ended without saving, it
+    // takes the place of the font file, as long as it's readable. But if the
+    // font has been saved since, by another session or another program, the
+    // recovery files are out of date, so they're discarded instead.
+    const auto autosave_path = autosave_path_for(path);
+    const auto autosave_current = is_newer(autosave_path, path);
+    auto from_autosave = autosave_current && _parse(read_file(autosave_path));
+    if (!from_autosave && !_parse(read_file(path)))
+        return false;
+    if (!autosave_current) {
+        auto error = std::error_code{};
+        std::filesystem::remove(autosave_path, error);
+    }
+    _path = path;
+    // Then any edits made after the last autosave are replayed from the
+    // journal. Replaying edits that were already autosaved is harmless, since
+    // each entry holds the full content of the glyph.
+    _journal.open(path, _cell_width, _cell_height);
+    if (!is_newer(_journal.path(), path))
+        _journal.remove();
+    const auto entries = _journal.read();
+    for (const auto& [index, pixels] : entries)
+        _store_glyph_pixels(index, pixels);
+    _recovered = from_autosave || !entries.empty();
+    _modified_since_snapshot = false;
+    return true;
+}
+
+bool glyph_manager::save(const std::filesystem::path& path)
+{
+    if (!_make_snapshot().write(path))
+        return false;
+    // Once saved, the recovery files are no longer needed, and future edits
+    // are journalled against the new path.
+    discard_unsaved();
+    _path = path;
+    _journal.open(path, _cell_width, _cell_height);
+    _recovered = false;
+    _modified_since_snapshot = false;
+    return true;
+}
+
+bool glyph_manager::recovered() const
+{
+    return _recovered;
+}
+
+void glyph_manager::discard_unsaved()
+{
+    _journal.remove();
+    if (!_path.empty()) {
+        auto error = std::error_code{};
+        std::filesystem::remove(autosave_path_for(_path), error);
+    }
+}
+
+bool glyph_manager::modified_since_snapshot() const
+{
+    return _modified_since_snapshot;
+}
+
+glyph_manager::snapshot glyph_manager::take_snapshot()
 {
-    auto file = std::ifstream{path, std::ios::binary};
-    const auto size = file_size(path);
-    auto contents = std::string(size, '\0');
-    file.read(contents.data(), size);
+    _modified_since_snapshot = false;
+    return _make_snapshot();
+}
 
+void glyph_manager::autosaved(const snapshot& snapshot, const bool success)
+{
+    // If the journal has moved on since the snapshot was taken, the font has
+    // been saved or replaced in the meantime, so the autosave is stale.
+    if (snapshot._journal_generation != _journal.generation()) {
+        auto error = std::error_code{};
+        std::filesystem::remove(snapshot._autosave_path, error);
+    } else if (success) {
+        _journal.discard_until(snapshot._journal_position);
+    }
+}
+
+const std::filesystem::path& glyph_manager::snapshot::autosave_path() const
+{
+    return _autosave_path;
+}
+
+bool glyph_manager::snapshot::write(const std::filesystem::path& path) const
+{
+    auto contents = _header;
+    for (auto i = 0; i < std::ssize(*_glyphs); i++) {
+        if (i) contents += ";";
+        contents += (*_glyphs)[i]->str();
+    }
+    contents += _trailer;
+
+    // We write to a temporary file first, and then rename it, so there's
+    // never a partially written file in place of the original. If the path
+    // is a symlink, it's the file it points to that gets replaced, and the
+    // permissions of that file are carried over to the new one.
+    // The links are followed one at a time, rather than canonicalized, so
+    // a link to a file that doesn't exist yet still works.
+    auto error = std::error_code{};
+    auto target_path = path;
+    for (auto links = 0; std::filesystem::is_symlink(target_path, error); links++) {
+        const auto link = std::filesystem::read_symlink(target_path, error);
+        if (error || links >= max_symlinks) return false;
+        target_path = target_path.parent_path() / link;
+    }
+    auto temp_path = target_path;
+    temp_path += ".tmp";
+    auto file = std::ofstream{temp_path, std::ios::binary};
+    file << contents;
+    file.close();
+    if (!file) return false;
+    const auto target_status = std::filesystem::status(target_path, error);
+    if (std::filesystem::exists(target_status))
+        std::filesystem::permissions(temp_path, target_status.permissions(), error);
+    std::filesystem::rename(temp_path, target_path, error);
+    return !error;
+}
+
+bool glyph_manager::_parse(const std::string& contents)
+{
     const auto pattern = R"EGEX((\x1BP|\x90|R"\()([\d\s;]*)\{([\s!-/]*[0-~])(\s*)([\s/;?-~]+?)(\s*)(\x1B|\x9C|\)";))EGEX";
     auto match = std::smatch{};
     if (std::regex_search(contents, match, std::regex(pattern))) {
@@ -170,10 +339,11 @@ bool glyph_manager::load(const std::filesystem::path& path)
         _sixel_prefix = match[4].str();
         _sixel_suffix = match[6].str();
         _terminator = match[7].str();
-        _glyphs.clear();
+        _glyphs = std::make_shared<glyph_table>();
         split(match[5].str(), ';', [&](const auto glyph_sixels) {
-            _glyphs.emplace_back(glyph_sixels);
+            _glyphs->push_back(std::make_shared<const glyph>(glyph_sixels));
         });
+        _revision++;
         _size = _parms->pcss().value_or(0) == 1 ? 96 : 94;
         _first_index = _parms->pcn().value_or(_size == 96 ? 0 : 1);
         std::tie(_cell_width, _cell_height, _pixel_aspect_ratio) = _detect_dimensions();
@@ -182,28 +352,29 @@ bool glyph_manager::load(const std::filesystem::path& path)
     return false;
 }
 
-bool glyph_manager::save(const std::filesystem::path& path)
+glyph_manager::snapshot glyph_manager::_make_snapshot() const
 {
-    auto contents = _prefix;
-    contents += _introducer;
-    contents += _parms->str();
-    contents += "{";
-    contents += _id;
-    contents += _sixel_prefix;
-
-    for (auto i = 0; i < _glyphs.size(); i++) {
-        if (i) contents += ";";
-        contents += _glyphs[i].str();
-    }
-
-    contents += _sixel_suffix;
-    contents += _terminator;
-    contents += _suffix;
-
-    auto file = std::ofstream{path, std::ios::binary};
-    file << contents;
+    // The glyph table is shared with the snapshot rather than copied, so
+    // this is cheap enough to do at any time. Edits made afterwards will
+    // copy the table before modifying it.
+    auto s = snapshot{};
+    s._header = _prefix + _introducer + _parms->str() + "{" + _id + _sixel_prefix;
+    s._trailer = _sixel_suffix + _terminator + _suffix;
+    s._glyphs = _glyphs;
+    if (!_path.empty()) s._autosave_path = autosave_path_for(_path);
+    s._journal_position = _journal.position();
+    s._journal_generation = _journal.generation();
+    return s;
+}
 
-    return true;
+glyph_manager::glyph_table& glyph_manager::_mutable_glyphs()
+{
+    // If the table is shared with a snapshot, we need our own copy before
+    // we can change it. Only the pointers are copied, though, since the
+    // glyphs themselves are never modified once they're in a table.
+    if (_glyphs.use_count() > 1)
+        _glyphs = std::make_shared<glyph_table>(*_glyphs);
+    return *_glyphs;
 }
 
 glyph_manager::parameters& glyph_manager::params()
@@ -272,30 +443,151 @@ int glyph_manager::pixel_aspect_ratio() const
     return _pixel_aspect_ratio;
 }
 
+int glyph_manager::revision() const
+{
+    // The revision changes whenever the content of the glyph table does, so
+    // anything mirroring the font can cheaply tell when it's out of date.
+    return _revision;
+}
+
 glyph_reference glyph_manager::operator[](const int index)
 {
     return {*this, index};
 }
 
+std::string glyph_manager::sixels(const int index) const
+{
+    // Any whitespace is stripped, since some terminals won't cope with that
+    // in DECDLD content.
+    const auto internal_index = index - _first_index;
+    if (internal_index < 0 || internal_index >= std::ssize(*_glyphs))
+        return {};
+    auto sixels = (*_glyphs)[internal_index]->str();
+    std::erase_if(sixels, [](const auto ch) { return !is_sixel_char(ch) && ch != '/'; });
+    return sixels;
+}
+
+std::string glyph_manager::decdld(const int first_index, const int last_index, const std::string_view id, const int buffer, const int erase) const
+{
+    // This builds the content of a DECDLD sequence for a range of glyphs,
+    // with the given font buffer, Dscs, and erase control, but otherwise
+    // using the parameters of the current font.
+    auto parms = *_parms;
+    parms.pfn(buffer);
+    parms.pcn(first_index);
+    parms.pe(erase);
+    auto s = parms.str() + "{" + std::string{id};
+    for (auto index = first_index; index <= last_index; index++) {
+        if (index > first_index) s += ";";
+        s += sixels(index);
+    }
+    return s;
+}
+
+std::vector<glyph_manager::change> glyph_manager::transform(const int first_index, const int last_index, const std::function<void(bitboard&)>& transform)
+{
+    // The glyphs are decoded, transformed, and re-encoded in parallel. The
+    // workers only read from a shared copy of the table, so the results are
+    // stored, and journalled, once they've all finished.
+    const auto table = std::shared_ptr<const glyph_table>{_glyphs};
+    const auto count = std::max(last_index - first_index + 1, 0);
+    auto changes = std::vector<change>(count);
+    auto new_glyphs = std::vector<std::shared_ptr<const glyph>>(count);
+    auto next = std::atomic<int>{0};
+    const auto worker = [&] {
+        for (auto i = next++; i < count; i = next++) {
+            const auto index = first_index + i;
+            const auto internal_index = index - _first_index;
+            const auto in_table = internal_index >= 0 && internal_index < std::ssize(*table);
+            auto updated_glyph = std::make_shared<glyph>(in_table ? *(*table)[internal_index] : glyph{""});
+            auto before = updated_glyph->pixels(_cell_width, _cell_height);
+            auto board = bitboard{before, _cell_width, 0, 0, _cell_width, _cell_height};
+            transform(board);
+            auto after = before;
+            board.store(after, _cell_width, 0, 0);
+            if (after != before) {
+                updated_glyph->pixels(_cell_width, _cell_height, after);
+                new_glyphs[i] = std::move(updated_glyph);
+                changes[i] = {index, std::move(before), std::move(after)};
+            }
+        }
+    };
+    const auto thread_count = std::clamp<int>(std::thread::hardware_concurrency(), 1, count ? count : 1);
+    auto threads = std::vector<std::thread>{};
+    for (auto i = 1; i < thread_count; i++)
+        threads.emplace_back(worker);
+    worker();
+    for (auto& thread : threads)
+        thread.join();
+
+    auto results = std::vector<change>{};
+    for (auto i = 0; i < count; i++) {
+        if (!new_glyphs[i]) continue;
+        _store_glyph(changes[i].index, std::move(new_glyphs[i]));
+        _journal.append(changes[i].index, changes[i].after);
+        _modified_since_snapshot = true;
+        results.push_back(std::move(changes[i]));
+    }
+    return results;
+}
+
+void glyph_manager::normalize()
+{
+    // Every glyph is decoded and then encoded again from scratch, so the
+    // sixels are left in a consistent form, without any whitespace, and
+    // covering the full cell. This isn't journalled, since it doesn't change
+    // the pixels of any glyph, but the encoding has changed, so it still
+    // needs to be picked up by the next autosave.
+    auto& glyphs = _mutable_glyphs();
+    for (auto& old_glyph : glyphs) {
+        auto new_glyph = std::make_shared<glyph>("");
+        new_glyph->pixels(_cell_width, _cell_height, old_glyph->pixels(_cell_width, _cell_height));
+        old_glyph = std::move(new_glyph);
+    }
+    _sixel_prefix.clear();
+    _sixel_suffix.clear();
+    _revision++;
+    _modified_since_snapshot = true;
+}
+
 std::vector<int8_t> glyph_manager::_glyph_pixels(const int index)
 {
     const auto internal_index = index - _first_index;
-    if (internal_index < 0 || internal_index >= _glyphs.size())
+    if (internal_index < 0 || internal_index >= std::ssize(*_glyphs))
         return std::vector<int8_t>(_cell_width * _cell_height, 0);
     else
-        return _glyphs[internal_index].pixels(_cell_width, _cell_height);
+        return (*_glyphs)[internal_index]->pixels(_cell_width, _cell_height);
 }
 
 void glyph_manager::_glyph_pixels(const int index, const std::vector<int8_t>& pixels)
 {
+    _store_glyph_pixels(index, pixels);
+    _journal.append(index, pixels);
+    _modified_since_snapshot = true;
+}
+
+void glyph_manager::_store_glyph_pixels(const int index, const std::vector<int8_t>& pixels)
+{
+    const auto internal_index = index - _first_index;
+    auto updated_glyph = std::make_shared<glyph>("");
+    if (internal_index >= 0 && internal_index < std::ssize(*_glyphs))
+        *updated_glyph = *(*_glyphs)[internal_index];
+    updated_glyph->pixels(_cell_width, _cell_height, pixels);
+    _store_glyph(index, std::move(updated_glyph));
+}
+
+void glyph_manager::_store_glyph(const int index, std::shared_ptr<const glyph> new_glyph)
+{
+    auto& glyphs = _mutable_glyphs();
     while (index < _first_index) {
-        _glyphs.insert(_glyphs.begin(), glyph{""});
+        glyphs.insert(glyphs.begin(), std::make_shared<const glyph>(""));
         _parms->pcn(--_first_index);
     }
     const auto internal_index = index - _first_index;
-    while (internal_index >= _glyphs.size())
-        _glyphs.emplace_back("");
-    _glyphs[internal_index].pixels(_cell_width, _cell_height, pixels);
+    while (internal_index >= std::ssize(glyphs))
+        glyphs.push_back(std::make_shared<const glyph>(""));
+    glyphs[internal_index] = std::move(new_glyph);
+    _revision++;
 }
 
 std::tuple<int, int, int> glyph_manager::_detect_dimensions()
@@ -343,9 +635,9 @@ std::tuple<int, int, int> glyph_manager::_detect_dimensions()
         return {declared_width, declared_height, pixel_aspect_ratio};
     }
     auto used_width = 0, used_height = 0;
-    for (auto glyph : _glyphs) {
-        used_width = std::max(used_width, glyph._used_width);
-        used_height = std::max(used_height, glyph._used_height);
+    for (const auto& glyph : *_glyphs) {
+        used_width = std::max(used_width, glyph->_used_width);
+        used_height = std::max(used_height, glyph->_used_height);
     }
     const auto in_range = [=](const auto cell_width, const auto cell_height) {
         const auto sixel_height = (cell_height + 5) / 6 * 6;
@@ -4,7 +4,11 @@
 
 #pragma once
 
+#include "journal.h"
+
+#include <cstdint>
 #include <filesystem>
+#include <functional>
 #include <memory>
 #include <optional>
 #include <string>
@@ -12,6 +16,7 @@
 #include <tuple>
 #include <vector>
 
+class bitboard;
 class glyph_manager;
 
 class glyph {
@@ -44,12 +49,23 @@ private:
 class glyph_manager {
 public:
     class parameters;
+    class snapshot;
+    struct change {
+        int index;
+        std::vector<int8_t> before;
+        std::vector<int8_t> after;
+    };
 
     glyph_manager();
     void clear();
     void clear(const std::vector<int>& params, const std::string_view id);
-    bool load(const std::filesystem::path& path);
+    bool load(const std::filesystem::path& path, const bool recover = true);
     bool save(const std::filesystem::path& path);
+    bool recovered() const;
+    void discard_unsaved();
+    bool modified_since_snapshot() const;
+    snapshot take_snapshot();
+    void autosaved(const snapshot& snapshot, const bool success);
     parameters& params();
     const parameters& params() const;
     const std::string& id() const;
@@ -61,13 +77,25 @@ public:
     int cell_width() const;
     int cell_height() const;
     int pixel_aspect_ratio() const;
+    int revision() const;
     glyph_reference operator[](const int index);
+    std::string sixels(const int index) const;
+    std::string decdld(const int first_index, const int last_index, const std::string_view id, const int buffer, const int erase) const;
+    std::vector<change> transform(const int first_index, const int last_index, const std::function<void(bitboard&)>& transform);
+    void normalize();
 
 private:
     friend glyph_reference;
 
+    using glyph_table = std::vector<std::shared_ptr<const glyph>>;
+
+    bool _parse(const std::string& contents);
+    snapshot _make_snapshot() const;
+    glyph_table& _mutable_glyphs();
     std::vector<int8_t> _glyph_pixels(const int index);
     void _glyph_pixels(const int _index, const std::vector<int8_t>& pixels);
+    void _store_glyph_pixels(const int _index, const std::vector<int8_t>& pixels);
+    void _store_glyph(const int index, std::shared_ptr<const glyph> new_glyph);
     std::tuple<int, int, int> _detect_dimensions();
 
     static constexpr int max_width = 16;
@@ -80,12 +108,33 @@ private:
     std::string _sixel_prefix;
     std::string _sixel_suffix;
     std::unique_ptr<parameters> _parms;
-    std::vector<glyph> _glyphs;
+    std::shared_ptr<glyph_table> _glyphs;
     int _size;
     int _first_index;
     int _cell_width;
     int _cell_height;
     int _pixel_aspect_ratio;
+    std::filesystem::path _path;
+    journal _journal;
+    bool _recovered = false;
+    bool _modified_since_snapshot = false;
+    int _revision = 0;
+};
+
+class glyph_manager::snapshot {
+public:
+    const std::filesystem::path& autosave_path() const;
+    bool write(const std::filesystem::path& path) const;
+
+private:
+    friend glyph_manager;
+
+    std::string _header;
+    std::string _trailer;
+    std::shared_ptr<const glyph_table> _glyphs;
+    std::filesystem::path _autosave_path;
+    std::uintmax_t _journal_position = 0;
+    int _journal_generation = 0;
 };
 
 class glyph_manager::parameters {
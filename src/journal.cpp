@@ -0,0 +1,208 @@
+// VT Font Maker
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#include "journal.h"
+
+#include "files.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+
+using namespace std::string_literals;
+
+namespace {
+
+    // The journal starts with a header identifying the format and the cell
+    // size, followed by a record for every glyph write. Each record holds the
+    // glyph index, the pixels packed eight to a byte, and a checksum, so a
+    // record that was only partially written can be detected on replay.
+    const auto header_magic = "VTFJ\x01"s;
+
+    int packed_size(const int cell_width, const int cell_height)
+    {
+        return (cell_width * cell_height + 7) / 8;
+    }
+
+    uint8_t checksum(const std::string_view data)
+    {
+        auto sum = 0;
+        for (const auto ch : data)
+            sum = (sum * 31 + static_cast<uint8_t>(ch)) & 0xFF;
+        return sum;
+    }
+
+}  // namespace
+
+journal::~journal()
+{
+    close();
+}
+
+void journal::open(const std::filesystem::path& font_path, const int cell_width, const int cell_height)
+{
+    close();
+    _generation++;
+    _path = font_path;
+    _path += ".journal";
+    _cell_width = cell_width;
+    _cell_height = cell_height;
+}
+
+void journal::close()
+{
+    if (_file) {
+        if (_sync_pending) _sync();
+        std::fclose(_file);
+        _file = nullptr;
+    }
+    _path.clear();
+}
+
+void journal::append(const int index, const std::vector<int8_t>& pixels)
+{
+    if (_path.empty()) return;
+    // The file isn't created until there's something to record, and an
+    // existing journal is appended to, since it may not have been replayed.
+    // Anything after the last complete record is cut off first, though, so a
+    // torn write can't hide the records that follow it, and a journal with
+    // an invalid header is started again.
+    if (!_file) {
+        auto entries = std::vector<entry>{};
+        const auto valid_size = _read(entries);
+        auto error = std::error_code{};
+        if (valid_size > 0)
+            std::filesystem::resize_file(_path, valid_size, error);
+        const auto reuse = valid_size > 0 && !error;
+        _file = std::fopen(_path.string().c_str(), reuse ? "ab" : "wb");
+        if (!_file) return;
+        if (!reuse) {
+            auto header = header_magic;
+            header += static_cast<char>(_cell_width);
+            header += static_cast<char>(_cell_height);
+            std::fwrite(header.data(), 1, header.size(), _file);
+        }
+    }
+    auto record = std::string{};
+    record += static_cast<char>(index);
+    auto packed = std::string(packed_size(_cell_width, _cell_height), '\0');
+    const auto pixel_count = std::min<std::size_t>(pixels.size(), _cell_width * _cell_height);
+    for (auto i = std::size_t{0}; i < pixel_count; i++)
+        if (pixels[i]) packed[i / 8] |= 1 << (i % 8);
+    record += packed;
+    record += static_cast<char>(checksum(record));
+    std::fwrite(record.data(), 1, record.size(), _file);
+    // The record is always handed over to the OS, so it survives the app
+    // crashing, but the more expensive sync is batched.
+    std::fflush(_file);
+    _sync_pending = true;
+    if (std::chrono::steady_clock::now() - _last_sync >= sync_interval)
+        _sync();
+}
+
+std::vector<journal::entry> journal::read() const
+{
+    auto entries = std::vector<entry>{};
+    _read(entries);
+    return entries;
+}
+
+void journal::remove()
+{
+    if (_file) {
+        std::fclose(_file);
+        _file = nullptr;
+    }
+    _sync_pending = false;
+    _generation++;
+    if (!_path.empty()) {
+        auto error = std::error_code{};
+        std::filesystem::remove(_path, error);
+    }
+}
+
+const std::filesystem::path& journal::path() const
+{
+    return _path;
+}
+
+std::uintmax_t journal::position() const
+{
+    if (_file) std::fflush(_file);
+    auto error = std::error_code{};
+    const auto size = std::filesystem::file_size(_path, error);
+    return error ? 0 : size;
+}
+
+int journal::generation() const
+{
+    // The generation changes whenever the journal is reopened or removed, so
+    // a position from an earlier generation can be recognised as stale.
+    return _generation;
+}
+
+void journal::discard_until(const std::uintmax_t position)
+{
+    // Records before the given position are no longer needed, typically
+    // because they've been autosaved, so we rewrite the journal with just the
+    // header and the records that followed.
+    if (_path.empty()) return;
+    if (_file) {
+        std::fclose(_file);
+        _file = nullptr;
+        _sync_pending = false;
+    }
+    auto file = std::ifstream{_path, std::ios::binary};
+    const auto contents = std::string{std::istreambuf_iterator<char>{file}, {}};
+    file.close();
+    const auto header_size = header_magic.size() + 2;
+    const auto keep_from = std::max<std::uintmax_t>(position, header_size);
+    auto error = std::error_code{};
+    if (contents.size() < header_size || keep_from >= contents.size()) {
+        std::filesystem::remove(_path, error);
+        return;
+    }
+    auto temp_path = _path;
+    temp_path += ".tmp";
+    auto temp_file = std::ofstream{temp_path, std::ios::binary};
+    temp_file << contents.substr(0, header_size) << contents.substr(keep_from);
+    temp_file.close();
+    if (temp_file)
+        std::filesystem::rename(temp_path, _path, error);
+}
+
+std::uintmax_t journal::_read(std::vector<entry>& entries) const
+{
+    // This returns the size of the journal up to the end of the last valid
+    // record, or zero if the header is missing or doesn't match.
+    auto file = std::ifstream{_path, std::ios::binary};
+    const auto contents = std::string{std::istreambuf_iterator<char>{file}, {}};
+    const auto header_size = header_magic.size() + 2;
+    if (!contents.starts_with(header_magic) || contents.size() < header_size)
+        return 0;
+    // A journal written for a different cell size can't be applied.
+    if (contents[header_magic.size()] != _cell_width || contents[header_magic.size() + 1] != _cell_height)
+        return 0;
+    const auto record_size = std::size_t(1 + packed_size(_cell_width, _cell_height) + 1);
+    auto offset = header_size;
+    for (; offset + record_size <= contents.size(); offset += record_size) {
+        const auto record = std::string_view{contents}.substr(offset, record_size - 1);
+        if (static_cast<uint8_t>(contents[offset + record_size - 1]) != checksum(record))
+            break;
+        auto pixels = std::vector<int8_t>(_cell_width * _cell_height);
+        for (auto i = std::size_t{0}; i < pixels.size(); i++)
+            pixels[i] = (record[1 + i / 8] >> (i % 8)) & 1;
+        entries.emplace_back(static_cast<uint8_t>(record[0]), std::move(pixels));
+    }
+    return offset;
+}
+
+void journal::_sync()
+{
+    files::sync(_file);
+    _last_sync = std::chrono::steady_clock::now();
+    _sync_pending = false;
+}
@@ -0,0 +1,41 @@
+// VT Font Maker
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <utility>
+#include <vector>
+
+class journal {
+public:
+    using entry = std::pair<int, std::vector<int8_t>>;
+
+    ~journal();
+    void open(const std::filesystem::path& font_path, const int cell_width, const int cell_height);
+    void close();
+    void append(const int index, const std::vector<int8_t>& pixels);
+    std::vector<entry> read() const;
+    void remove();
+    const std::filesystem::path& path() const;
+    std::uintmax_t position() const;
+    int generation() const;
+    void discard_until(const std::uintmax_t position);
+
+private:
+    std::uintmax_t _read(std::vector<entry>& entries) const;
+    void _sync();
+
+    static constexpr auto sync_interval = std::chrono::seconds{1};
+    std::filesystem::path _path;
+    std::FILE* _file = nullptr;
+    int _cell_width = 0;
+    int _cell_height = 0;
+    std::chrono::steady_clock::time_point _last_sync;
+    bool _sync_pending = false;
+    int _generation = 0;
+};
@@ -4,13 +4,181 @@
 
 #include "macros.h"
 
+#include "capabilities.h"
 #include "vt.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <map>
+
+namespace {
+
+    struct macro_entry {
+        // The callback is kept so the macro can be regenerated if it needs
+        // to be evicted from the terminal and later invoked again.
+        macro_callback callback;
+        std::string text;
+        std::vector<int> dependencies;
+        // The encoded content that was last uploaded, and its hash, which
+        // is checked first, since that's usually enough to detect a change.
+        std::string content;
+        std::size_t hash = 0;
+        int size = 0;
+        bool pending = true;
+        bool uploaded = false;
+        uint64_t last_used = 0;
+    };
+
+    std::map<int, macro_entry> macros;
+    std::vector<int> released_ids;
+    uint64_t usage_clock = 0;
+    int space_available = 0;
+    int space_used = 0;
+
+    std::string generate(macro_entry& entry)
+    {
+        auto buffer = macro_buffer{};
+        auto buffer_stream = std::ostream(&buffer);
+        auto vt_stream = macro_stream{buffer, buffer_stream};
+        entry.callback(vt_stream);
+        vt_stream.flush();
+        entry.text = std::move(buffer.text());
+        entry.dependencies = std::move(buffer.dependencies());
+        return std::move(buffer.encoded());
+    }
+
+    void evict(const int id, macro_entry& entry)
+    {
+        vtout.decdmac(id, {}, {});
+        entry.uploaded = false;
+        space_used -= entry.size;
+    }
+
+    bool make_space(const int size, const std::vector<int>& pinned, const bool allow_eviction)
+    {
+        // If the terminal didn't report its macro space, we assume there's
+        // no limit, and hope for the best.
+        if (space_available == 0) return true;
+        while (space_used + size > space_available) {
+            if (!allow_eviction) return false;
+            auto lru = macros.end();
+            for (auto it = macros.begin(); it != macros.end(); it++) {
+                const auto is_pinned = std::find(pinned.begin(), pinned.end(), it->first) != pinned.end();
+                if (it->second.uploaded && !is_pinned)
+                    if (lru == macros.end() || it->second.last_used < lru->second.last_used)
+                        lru = it;
+            }
+            if (lru == macros.end()) return false;
+            evict(lru->first, lru->second);
+        }
+        return true;
+    }
+
+    bool upload(const int id, std::vector<int>& pinned, const bool allow_eviction = true);
+
+    bool upload_dependencies(const int id, std::vector<int>& pinned, const bool allow_eviction)
+    {
+        // The dependencies are all pinned first, so that loading one of them
+        // can't evict another that is already loaded.
+        const auto dependencies = macros[id].dependencies;
+        pinned.push_back(id);
+        pinned.insert(pinned.end(), dependencies.begin(), dependencies.end());
+        for (const auto dependency : dependencies) {
+            if (!macros.contains(dependency)) continue;
+            const auto loaded = macros[dependency].uploaded
+                ? upload_dependencies(dependency, pinned, allow_eviction)
+                : upload(dependency, pinned, allow_eviction);
+            if (!loaded) return false;
+        }
+        return true;
+    }
+
+    bool upload(const int id, std::vector<int>& pinned, const bool allow_eviction)
+    {
+        auto& entry = macros[id];
+        entry.pending = false;
+        const auto content = generate(entry);
+        const auto hash = std::hash<std::string>{}(content);
+        // If any of the macros this one invokes can't be loaded, there's no
+        // point in loading it either, and if it was previously loaded, the
+        // old content is out of date, so that has to be erased.
+        const auto fail = [&] {
+            if (entry.uploaded) evict(id, entry);
+            return false;
+        };
+        if (!upload_dependencies(id, pinned, allow_eviction))
+            return fail();
+        // There's no need to send anything if the terminal already has
+        // exactly the same content defined for this ID. A matching hash
+        // isn't proof of that, so the content itself is also compared.
+        if (entry.uploaded && entry.hash == hash && entry.content == content)
+            return true;
+        // When a macro is redefined, the terminal releases the old content,
+        // so we only need to make space for the difference in size. The
+        // accounting isn't updated until the upload has actually happened.
+        const auto old_size = entry.uploaded ? entry.size : 0;
+        const auto new_size = int(entry.text.length());
+        if (!make_space(new_size - old_size, pinned, allow_eviction))
+            return fail();
+        vtout.decdmac(id, {}, 1, content);
+        entry.content = content;
+        entry.hash = hash;
+        entry.size = new_size;
+        entry.uploaded = true;
+        space_used += new_size - old_size;
+        return true;
+    }
+
+    std::string expand(const int id)
+    {
+        // When a macro can't be loaded, its content is sent directly, but the
+        // macros it invokes might not be loaded either, so those invocations
+        // are replaced with their own expanded content.
+        auto& entry = macros[id];
+        if (entry.text.empty() && entry.callback) generate(entry);
+        auto text = entry.text;
+        for (const auto dependency : entry.dependencies) {
+            if (!macros.contains(dependency) || macros[dependency].uploaded) continue;
+            auto invocation_stream = std::ostringstream{};
+            auto invocation_vt = vt_stream{invocation_stream};
+            invocation_vt.decinvm(dependency);
+            invocation_vt.flush();
+            const auto invocation = invocation_stream.str();
+            const auto expansion = expand(dependency);
+            for (auto pos = text.find(invocation); pos != std::string::npos; pos = text.find(invocation, pos + expansion.length()))
+                text.replace(pos, invocation.length(), expansion);
+        }
+        return text;
+    }
+
+    void touch(const int id)
+    {
+        if (const auto it = macros.find(id); it != macros.end()) {
+            it->second.last_used = ++usage_clock;
+            for (const auto dependency : it->second.dependencies)
+                touch(dependency);
+        }
+    }
+
+}  // namespace
+
+void macro_manager::initialize(const capabilities& caps)
+{
+    space_available = caps.macro_space;
+}
+
 int macro_manager::reserve_id()
 {
     static int _next_id = 0;
     // Clear out all existing macros on first use.
     if (_next_id == 0) vtout.decdmac({}, 1, {});
+    // IDs that have been released are reused before allocating new ones.
+    if (!released_ids.empty()) {
+        const auto id = released_ids.back();
+        released_ids.pop_back();
+        return id;
+    }
     return _next_id++;
 }
 
@@ -21,28 +189,116 @@ int macro_manager::create(macro_callback callback)
 
 int macro_manager::create(const int id, macro_callback callback)
 {
-    auto buffer = macro_buffer{};
-    auto buffer_stream = std::ostream(&buffer);
-    auto vt_stream = macro_stream{buffer, buffer_stream};
-    callback(vt_stream);
-    vt_stream.flush();
-    vtout.decdmac(id, {}, 1, buffer.encoded());
+    macros[id].callback = callback;
+    auto pinned = std::vector<int>{};
+    upload(id, pinned);
+    return id;
+}
+
+int macro_manager::define(macro_callback callback)
+{
+    return define(reserve_id(), callback);
+}
+
+int macro_manager::define(const int id, macro_callback callback)
+{
+    // The content isn't generated until the macro is first invoked, or the
+    // application has some idle time in which to upload it. This means the
+    // callback mustn't capture anything by reference that won't outlive it.
+    auto& entry = macros[id];
+    entry.callback = callback;
+    entry.pending = true;
     return id;
 }
 
+void macro_manager::invoke(const int id)
+{
+    auto& entry = macros[id];
+    auto pinned = std::vector<int>{};
+    auto loaded = entry.uploaded;
+    if (!loaded && entry.callback) {
+        loaded = upload(id, pinned);
+    } else if (loaded) {
+        // Even if this macro is still loaded, its dependencies may not be.
+        loaded = upload_dependencies(id, pinned, true);
+    }
+    touch(id);
+    // If there isn't enough macro space available, we fall back to sending
+    // the content directly.
+    if (loaded)
+        vtout.decinvm(id);
+    else
+        vtout.write(expand(id));
+}
+
+void macro_manager::release(const int id)
+{
+    if (const auto it = macros.find(id); it != macros.end()) {
+        if (it->second.uploaded)
+            evict(id, it->second);
+        macros.erase(it);
+    }
+    released_ids.push_back(id);
+}
+
+bool macro_manager::upload_pending()
+{
+    const auto pending = std::find_if(macros.begin(), macros.end(), [](const auto& it) {
+        return it.second.pending;
+    });
+    if (pending == macros.end())
+        return false;
+    // We don't want to evict anything at this point, since the pending macro
+    // may never be used, so if it doesn't fit, it'll wait until it's needed.
+    auto pinned = std::vector<int>{};
+    upload(pending->first, pinned, false);
+    return true;
+}
+
 int macro_buffer::sync()
 {
+    static constexpr auto hex = "0123456789ABCDEF";
     const auto& text = str();
+    _text += text;
     _encoded.reserve(_encoded.size() + text.length() * 2);
-    for (auto i = 0, offset = 0; i < text.length(); i++) {
-        static constexpr auto hex = "0123456789ABCDEF";
-        _encoded += hex[(text[i] >> 4) & 0x0F];
-        _encoded += hex[text[i] & 0x0F];
+    for (auto i = std::size_t{0}; i < text.length();) {
+        const auto ch = text[i];
+        auto run = std::size_t{1};
+        while (i + run < text.length() && text[i + run] == ch)
+            run++;
+        // A run of identical characters can be compressed with a repeat
+        // sequence, as long as we aren't already inside a repeat, and the
+        // sequence is actually shorter than the plain hex.
+        const auto count = std::to_string(run);
+        const auto repeat_length = 5 + count.length();
+        if (!_repeating && repeat_length < run * 2) {
+            _encoded += '!';
+            _encoded += count;
+            _encoded += ';';
+            _encoded += hex[(ch >> 4) & 0x0F];
+            _encoded += hex[ch & 0x0F];
+            _encoded += ';';
+            i += run;
+        } else {
+            _encoded += hex[(ch >> 4) & 0x0F];
+            _encoded += hex[ch & 0x0F];
+            i++;
+        }
     }
     str("");
     return 0;
 }
 
+const std::string& macro_buffer::text() const
+{
+    return _text;
+}
+
+std::string& macro_buffer::text()
+{
+    return _text;
+}
+
 const std::string& macro_buffer::encoded() const
 {
     return _encoded;
@@ -53,6 +309,21 @@ std::string& macro_buffer::encoded()
     return _encoded;
 }
 
+const std::vector<int>& macro_buffer::dependencies() const
+{
+    return _dependencies;
+}
+
+std::vector<int>& macro_buffer::dependencies()
+{
+    return _dependencies;
+}
+
+void macro_buffer::repeating(const bool repeating)
+{
+    _repeating = repeating;
+}
+
 macro_stream::macro_stream(macro_buffer& buffer, std::ostream& buffer_stream)
     : vt_stream{buffer_stream}, _buffer{buffer}
 {
@@ -65,7 +336,26 @@ void macro_stream::repeat(const int count, macro_callback callback)
     encoded.push_back('!');
     encoded.append(std::to_string(count));
     encoded.push_back(';');
+    // Repeat sequences can't be nested, so the buffer mustn't compress any
+    // of the content inside this one.
+    _buffer.repeating(true);
+    const auto text_start = _buffer.text().length();
     callback(*this);
     flush();
+    _buffer.repeating(false);
     encoded.push_back(';');
+    // The plain text is kept fully expanded, since that's what the terminal
+    // would be executing, and what we'd need to send directly.
+    auto& text = _buffer.text();
+    const auto repeated_text = text.substr(text_start);
+    for (auto i = 1; i < count; i++)
+        text += repeated_text;
+}
+
+void macro_stream::decinvm(const vt_parm id)
+{
+    // Keep track of nested invocations, so we can make sure the target is
+    // loaded whenever this macro is.
+    _buffer.dependencies().push_back(id);
+    vt_stream::decinvm(id);
 }
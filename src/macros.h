@@ -9,31 +9,48 @@
 #include <functional>
 #include <sstream>
 #include <string>
+#include <vector>
 
+class capabilities;
 class macro_stream;
 using macro_callback = std::function<void(macro_stream&)>;
 
 class macro_manager {
 public:
+    static void initialize(const capabilities& caps);
     static int reserve_id();
     static int create(macro_callback callback);
     static int create(const int id, macro_callback callback);
+    static int define(macro_callback callback);
+    static int define(const int id, macro_callback callback);
+    static void invoke(const int id);
+    static void release(const int id);
+    static bool upload_pending();
 };
 
 class macro_buffer : public std::stringbuf {
 public:
     virtual int sync();
+    const std::string& text() const;
+    std::string& text();
     const std::string& encoded() const;
     std::string& encoded();
+    const std::vector<int>& dependencies() const;
+    std::vector<int>& dependencies();
+    void repeating(const bool repeating);
 
 private:
+    std::string _text;
     std::string _encoded;
+    std::vector<int> _dependencies;
+    bool _repeating = false;
 };
 
 class macro_stream : public vt_stream {
 public:
     macro_stream(macro_buffer& buffer, std::ostream& buffer_stream);
     void repeat(const int count, macro_callback callback);
+    void decinvm(const vt_parm id);
 
 private:
     macro_buffer& _buffer;
@@ -5,11 +5,17 @@
 #include "application.h"
 #include "capabilities.h"
 #include "coloring.h"
+#include "delta.h"
 #include "dialog.h"
 #include "font.h"
+#include "glyphs.h"
+#include "macros.h"
 #include "os.h"
 #include "vt.h"
 
+#include <fstream>
+#include <iostream>
+
 bool check_compatibility(const capabilities& caps)
 {
     const auto compatible =
@@ -37,10 +43,61 @@ bool check_compatibility(const capabilities& caps)
     return true;
 }
 
+int create_delta(const std::vector<std::string>& args)
+{
+    // This runs without a terminal, so it doesn't go through the os class,
+    // and the sequences are written as raw bytes rather than via vtout.
+    if (args.size() < 2 || args.size() > 3) {
+        std::cerr << "Usage: vtfontmaker delta OLD_FONT NEW_FONT [OUTPUT]\n";
+        return 2;
+    }
+    auto old_glyphs = glyph_manager{};
+    auto new_glyphs = glyph_manager{};
+    for (auto [glyphs, path] : {std::pair{&old_glyphs, args[0]}, std::pair{&new_glyphs, args[1]}}) {
+        if (!glyphs->load(path, false)) {
+            std::cerr << path << ": not a valid font file\n";
+            return 1;
+        }
+    }
+
+    const auto delta = font_delta{old_glyphs, new_glyphs};
+    auto file = std::ofstream{};
+    if (args.size() == 3) {
+        file.open(args[2], std::ios::binary);
+        if (!file) {
+            std::cerr << args[2] << ": unable to create file\n";
+            return 1;
+        }
+    }
+    auto& output = args.size() == 3 ? file : std::cout;
+    for (const auto& sequence : delta.sequences())
+        output << sequence;
+    output.flush();
+
+    if (!delta.incremental())
+        std::cerr << "Font layout has changed, so the full font is required\n";
+    else
+        std::cerr << delta.changed_count() << " glyphs changed, " << delta.sequences().size() << " sequences\n";
+    return output ? 0 : 1;
+}
+
 int main(int argc, const char* argv[])
 {
+    if (argc >= 2 && std::string{argv[1]} == "delta")
+        return create_delta({argv + 2, argv + argc});
+
+    auto start_path = std::filesystem::path{};
+    auto reprobe = false;
+    for (int i = 1; i < argc; i++) {
+        auto arg = std::string{argv[i]};
+        if (arg == "--reprobe")
+            reprobe = true;
+        else if (!arg.starts_with("-") && start_path.empty())
+            start_path = std::filesystem::current_path().append(arg);
+    }
+
     os os;
-    capabilities caps;
+    capabilities caps{reprobe};
     if (!check_compatibility(caps))
         return 1;
 
@@ -66,15 +123,7 @@ int main(int argc, const char* argv[])
     // Setup the color palette.
     const auto colors = coloring{caps};
 
-    auto start_path = std::filesystem::path{};
-    for (int i = 1; i < argc; i++) {
-        auto arg = std::string{argv[i]};
-        if (!arg.starts_with("-")) {
-            start_path = std::filesystem::current_path().append(arg);
-            break;
-        }
-    }
-
+    macro_manager::initialize(caps);
     dialog::initialize(caps);
     keyboard::initialize(caps);
     application app{caps, start_path};
@@ -90,12 +139,10 @@ int main(int argc, const char* argv[])
     vtout.sgr({});
     // Clear all pages.
     vtout.cup();
-    vtout.ppa(3);
-    vtout.ed();
-    vtout.ppa(2);
-    vtout.ed();
-    vtout.ppa(1);
-    vtout.ed();
+    for (auto page = caps.page_count; page >= 1; page--) {
+        vtout.ppa(page);
+        vtout.ed();
+    }
     // Show the cursor and reenable autowrap.
     vtout.sm('?', {25, 7});
     // Restore default character set.
@@ -63,7 +63,7 @@ menu_group::menu_group(const std::wstring_view name, const int xoffset, const st
 {
     _open_macro = macro_manager::reserve_id();
     if (_close_macro == -1) {
-        _close_macro = macro_manager::create([](auto& macro) {
+        _close_macro = macro_manager::define([](auto& macro) {
             macro.deccra({}, {}, {}, {}, 2, {}, {}, 1);
             macro.decstbm();
             macro.decslrm();
@@ -102,7 +102,7 @@ void menu_group::render() const
 
 void menu_group::open()
 {
-    vtout.decinvm(_open_macro);
+    macro_manager::invoke(_open_macro);
     for (auto i = 0; i < _entry_ids.size(); i++)
         if (_disabled(i))
             vtout.deccara(i + 1, {}, i + 1, {}, color::secondary_disabled);
@@ -114,7 +114,7 @@ void menu_group::open()
 
 void menu_group::close()
 {
-    vtout.decinvm(_close_macro);
+    macro_manager::invoke(_close_macro);
 }
 
 std::optional<int> menu_group::process_key(const key keypress)
@@ -168,20 +168,23 @@ menu_builder::menu_builder(menu_group& group, std::unordered_map<key, int>& acce
 
 menu_builder::~menu_builder()
 {
-    macro_manager::create(_group.macro_id(), [&](auto& macro) {
-        macro.deccara({}, _group.left(), 1, _group.right(), color::primary_focus);
-        macro.decslrm(_group.left(), _group.left() + _width);
-        macro.decstbm(2, _entries.size() + 1);
+    // The dropdown isn't uploaded until it's first opened (or there's some
+    // idle time), so the callback needs its own copy of the entries.
+    auto& group = _group;
+    macro_manager::define(group.macro_id(), [&group, entries = _entries, width = _width](auto& macro) {
+        macro.deccara({}, group.left(), 1, group.right(), color::primary_focus);
+        macro.decslrm(group.left(), group.left() + width);
+        macro.decstbm(2, entries.size() + 1);
         macro.deccra({}, {}, {}, {}, 1, {}, {}, 2);
         macro.sgr(color::secondary_init);
         auto yoffset = 1;
-        for (auto& entry : _entries) {
+        for (auto& entry : entries) {
             const auto& [name, accelerator_name, has_separator] = entry;
             macro.cup(yoffset++);
             if (has_separator) macro.sgr({53});
             macro.write(' ');
             macro.write(markup_label(name));
-            macro.write_spaces(_width - name.length() - accelerator_name.length());
+            macro.write_spaces(width - name.length() - accelerator_name.length());
             macro.write(accelerator_name);
             macro.write(' ');
             if (has_separator) macro.sgr({55});
@@ -8,9 +8,38 @@
 
 #include <Windows.h>
 
+#include <chrono>
+#include <cstdlib>
+
 DWORD output_mode;
 DWORD input_mode;
 
+namespace {
+
+    bool wait_for_key(const HANDLE input_handle, const int timeout_ms)
+    {
+        // The input handle is also signalled for focus, mouse, and window size
+        // events, and for key events that don't produce any characters, so
+        // those are discarded, and we keep waiting for the time remaining.
+        using namespace std::chrono;
+        const auto deadline = steady_clock::now() + milliseconds{timeout_ms};
+        for (;;) {
+            auto record = INPUT_RECORD{};
+            auto count = DWORD{0};
+            while (PeekConsoleInputW(input_handle, &record, 1, &count) && count == 1) {
+                const auto& key_event = record.Event.KeyEvent;
+                if (record.EventType == KEY_EVENT && key_event.bKeyDown && key_event.uChar.UnicodeChar != 0)
+                    return true;
+                ReadConsoleInputW(input_handle, &record, 1, &count);
+            }
+            const auto remaining = duration_cast<milliseconds>(deadline - steady_clock::now()).count();
+            if (remaining <= 0 || WaitForSingleObject(input_handle, static_cast<DWORD>(remaining)) != WAIT_OBJECT_0)
+                return false;
+        }
+    }
+
+}  // namespace
+
 os::os()
 {
     HANDLE output_handle = GetStdHandle(STD_OUTPUT_HANDLE);
@@ -41,6 +70,26 @@ int os::getch()
     return chars_read == 1 ? static_cast<int>(ch) : -1;
 }
 
+int os::getch(const int timeout_ms)
+{
+    HANDLE input_handle = GetStdHandle(STD_INPUT_HANDLE);
+    if (!wait_for_key(input_handle, timeout_ms))
+        return -1;
+    return getch();
+}
+
+bool os::has_input()
+{
+    HANDLE input_handle = GetStdHandle(STD_INPUT_HANDLE);
+    return wait_for_key(input_handle, 0);
+}
+
+bool os::has_input(const int timeout_ms)
+{
+    HANDLE input_handle = GetStdHandle(STD_INPUT_HANDLE);
+    return wait_for_key(input_handle, timeout_ms);
+}
+
 bool os::is_file_hidden(const std::filesystem::path& filepath)
 {
     auto attrs = WIN32_FILE_ATTRIBUTE_DATA{};
@@ -50,15 +99,26 @@ bool os::is_file_hidden(const std::filesystem::path& filepath)
         return true;
 }
 
+std::filesystem::path os::cache_path()
+{
+    const auto local_app_data = _wgetenv(L"LOCALAPPDATA");
+    if (local_app_data && *local_app_data)
+        return std::filesystem::path{local_app_data}.append(L"vtfontmaker");
+    else
+        return {};
+}
+
 #endif
 
 #ifdef __linux__
 
+#include <poll.h>
 #include <signal.h>
 #include <termios.h>
 #include <unistd.h>
 
 #include <cstdio>
+#include <cstdlib>
 
 struct termios term_attributes;
 
@@ -78,7 +138,30 @@ os::~os()
 
 int os::getch()
 {
-    return getchar();
+    // We read directly from the file descriptor rather than using stdio, so
+    // there's no hidden buffering that poll wouldn't know about.
+    unsigned char ch;
+    return read(STDIN_FILENO, &ch, 1) == 1 ? static_cast<int>(ch) : -1;
+}
+
+int os::getch(const int timeout_ms)
+{
+    auto fds = pollfd{STDIN_FILENO, POLLIN, 0};
+    if (poll(&fds, 1, timeout_ms) <= 0)
+        return -1;
+    return getch();
+}
+
+bool os::has_input()
+{
+    auto fds = pollfd{STDIN_FILENO, POLLIN, 0};
+    return poll(&fds, 1, 0) > 0;
+}
+
+bool os::has_input(const int timeout_ms)
+{
+    auto fds = pollfd{STDIN_FILENO, POLLIN, 0};
+    return poll(&fds, 1, timeout_ms) > 0;
 }
 
 bool os::is_file_hidden(const std::filesystem::path& filepath)
@@ -86,4 +169,15 @@ bool os::is_file_hidden(const std::filesystem::path& filepath)
     return *filepath.c_str() == '.';
 }
 
+std::filesystem::path os::cache_path()
+{
+    const auto xdg_cache_home = getenv("XDG_CACHE_HOME");
+    if (xdg_cache_home && *xdg_cache_home)
+        return std::filesystem::path{xdg_cache_home}.append("vtfontmaker");
+    const auto home = getenv("HOME");
+    if (home && *home)
+        return std::filesystem::path{home}.append(".cache").append("vtfontmaker");
+    return {};
+}
+
 #endif
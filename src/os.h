@@ -11,5 +11,9 @@ public:
     os();
     ~os();
     static int getch();
+    static int getch(const int timeout_ms);
+    static bool has_input();
+    static bool has_input(const int timeout_ms);
     static bool is_file_hidden(const std::filesystem::path& filepath);
+    static std::filesystem::path cache_path();
 };
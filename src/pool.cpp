@@ -0,0 +1,74 @@
+// VT Font Maker
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#include "pool.h"
+
+#include <algorithm>
+#include <thread>
+
+work_pool::work_pool(const int thread_count)
+    : _thread_count{thread_count > 0 ? thread_count : std::max<int>(std::thread::hardware_concurrency(), 1)}
+{
+    for (auto i = 0; i < _thread_count; i++)
+        _queues.push_back(std::make_unique<queue>());
+}
+
+int work_pool::thread_count() const
+{
+    return _thread_count;
+}
+
+void work_pool::run(std::vector<task> tasks)
+{
+    // The tasks are dealt out to the workers in turn, but they won't all
+    // take the same time, so a worker that runs out of tasks will steal
+    // from the others rather than sitting idle.
+    for (auto i = std::size_t{0}; i < tasks.size(); i++)
+        _queues[i % _thread_count]->tasks.push_back(std::move(tasks[i]));
+    const auto thread_count = std::min<int>(_thread_count, tasks.size());
+    auto threads = std::vector<std::thread>{};
+    for (auto worker = 1; worker < thread_count; worker++)
+        threads.emplace_back(&work_pool::_work, this, worker);
+    _work(0);
+    for (auto& thread : threads)
+        thread.join();
+}
+
+void work_pool::_work(const int worker)
+{
+    // Tasks never add more tasks, so once there's nothing left to take or
+    // steal, there's no more work to be done.
+    for (auto task = _pop(worker); task; task = _pop(worker))
+        task.value()();
+}
+
+std::optional<work_pool::task> work_pool::_pop(const int worker)
+{
+    // A worker takes from the front of its own queue, and steals from the
+    // back of the others, so it's less likely to contend with their owners.
+    auto& own = *_queues[worker];
+    {
+        auto lock = std::lock_guard{own.mutex};
+        if (!own.tasks.empty()) {
+            auto task = std::move(own.tasks.front());
+            own.tasks.pop_front();
+            return task;
+        }
+    }
+    return _steal(worker);
+}
+
+std::optional<work_pool::task> work_pool::_steal(const int worker)
+{
+    for (auto i = 1; i < _thread_count; i++) {
+        auto& victim = *_queues[(worker + i) % _thread_count];
+        auto lock = std::lock_guard{victim.mutex};
+        if (!victim.tasks.empty()) {
+            auto task = std::move(victim.tasks.back());
+            victim.tasks.pop_back();
+            return task;
+        }
+    }
+    return {};
+}
@@ -0,0 +1,34 @@
+// VT Font Maker
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+class work_pool {
+public:
+    using task = std::function<void()>;
+
+    work_pool(const int thread_count = 0);
+    int thread_count() const;
+    void run(std::vector<task> tasks);
+
+private:
+    struct queue {
+        std::mutex mutex;
+        std::deque<task> tasks;
+    };
+
+    void _work(const int worker);
+    std::optional<task> _pop(const int worker);
+    std::optional<task> _steal(const int worker);
+
+    int _thread_count;
+    std::vector<std::unique_ptr<queue>> _queues;
+};
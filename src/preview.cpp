@@ -0,0 +1,172 @@
+// VT Font Maker
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#include "preview.h"
+
+#include "capabilities.h"
+#include "dialog.h"
+#include "font.h"
+#include "glyphs.h"
+#include "vt.h"
+
+#include <algorithm>
+#include <format>
+
+namespace {
+
+    constexpr auto wallpaper_color = {0, 37, 45};  // White on LighterBlue
+    constexpr auto sample_color = {0, 37, 40};     // White on Black
+
+}  // namespace
+
+preview_font::preview_font(glyph_manager& glyphs)
+    : _glyphs{glyphs}
+{
+}
+
+preview_font::~preview_font()
+{
+    // Make sure the ASCII character set is restored on exit.
+    if (_loaded) vtout.scs(3, "B");
+}
+
+void preview_font::load()
+{
+    // Nothing is uploaded until something first needs the font, but from
+    // then on we keep the terminal's copy up to date.
+    _loaded = true;
+    upload();
+}
+
+void preview_font::update()
+{
+    // This is called once the canvas has been flushed, so any edits will
+    // have been committed to the glyph manager. Rather than uploading them
+    // straight away, we wait until the editing pauses, so a stream of key
+    // presses doesn't become a stream of DECDLD sequences.
+    if (!_loaded || _glyphs.revision() == _revision) return;
+    _revision = _glyphs.revision();
+    _last_change = clock::now();
+    if (!_first_change) _first_change = _last_change;
+}
+
+std::optional<int> preview_font::upload_delay() const
+{
+    // The delay is restarted with every change, but the upload can't be
+    // put off indefinitely, otherwise the preview would never update while
+    // a key is held down.
+    if (!_first_change) return {};
+    const auto due = std::min(_last_change + debounce_delay, _first_change.value() + max_upload_delay);
+    const auto delay = std::chrono::duration_cast<std::chrono::milliseconds>(due - clock::now());
+    return std::max<int>(delay.count(), 0);
+}
+
+void preview_font::upload()
+{
+    if (!_loaded) return;
+    _first_change.reset();
+    _revision = _glyphs.revision();
+
+    const auto size = _glyphs.size();
+    const auto min_index = size == 96 ? 0 : 1;
+    const auto max_index = size == 96 ? 95 : 94;
+    const auto layout = std::format("{}x{}x{}", _glyphs.cell_width(), _glyphs.cell_height(), size);
+    if (layout != _layout) {
+        // If the cell size or character set size has changed, the whole font
+        // needs to be reloaded, erasing what was there before.
+        _layout = layout;
+        _uploaded.assign(96, {});
+        for (auto index = min_index; index <= max_index; index++)
+            _uploaded[index] = _glyphs.sixels(index);
+        _upload(min_index, max_index, 0);
+        if (size == 96)
+            vtout.scs96(3, soft_font::preview_id);
+        else
+            vtout.scs(3, soft_font::preview_id);
+        return;
+    }
+
+    // Otherwise we only upload the glyphs that have changed, with runs of
+    // adjacent glyphs combined into a single DECDLD. The erase control is
+    // set so nothing else in the buffer is affected.
+    for (auto index = min_index; index <= max_index;) {
+        auto last_index = index;
+        while (last_index <= max_index) {
+            auto sixels = _glyphs.sixels(last_index);
+            if (sixels == _uploaded[last_index]) break;
+            _uploaded[last_index++] = std::move(sixels);
+        }
+        if (last_index > index) _upload(index, last_index - 1, 1);
+        index = last_index + 1;
+    }
+}
+
+void preview_font::_upload(const int first_index, const int last_index, const int erase)
+{
+    vtout.dcs(_glyphs.decdld(first_index, last_index, soft_font::preview_id, soft_font::preview_buffer, erase));
+}
+
+sample_text::sample_text(const capabilities& caps, preview_font& font)
+    : _font{font}, _row{caps.height - 1}, _width{caps.width}
+{
+}
+
+bool sample_text::visible() const
+{
+    return _visible;
+}
+
+void sample_text::toggle()
+{
+    _visible = !_visible;
+    if (_visible)
+        render();
+    else
+        _erase();
+}
+
+void sample_text::edit()
+{
+    auto dlg = dialog{L"Sample Text"};
+    auto& text_field = dlg.add_input(L"Text", std::min(_width - 20, 60));
+    auto& buttons = dlg.add_group(dialog::alignment::right);
+    buttons.add_button(L"OK", 1, true);
+    buttons.add_button(L"Cancel", 2);
+
+    text_field.value(std::wstring{_text.begin(), _text.end()});
+
+    if (dlg.show() == 1) {
+        // Only the printable ASCII range maps onto the soft font, so anything
+        // else is dropped.
+        _text.clear();
+        for (const auto ch : text_field.value())
+            if (ch >= L' ' && ch <= L'~') _text += char(ch);
+        _visible = true;
+        render();
+    }
+}
+
+void sample_text::render()
+{
+    // The sample occupies the row below the canvas, which is otherwise just
+    // wallpaper. Because it's written with the preview font, the terminal
+    // redraws it by itself whenever the font is uploaded again.
+    if (!_visible) return;
+    _font.load();
+    const auto text = std::string_view{_text}.substr(0, _width - 2);
+    vtout.sgr(sample_color);
+    vtout.decfra(' ', _row, {}, _row, {});
+    vtout.cup(_row, (_width - int(text.length())) / 2 + 1);
+    vtout.ls3();
+    vtout.write(text);
+    vtout.ls0();
+}
+
+void sample_text::_erase()
+{
+    vtout.ls1();
+    vtout.sgr(wallpaper_color);
+    vtout.decfra('@', _row, {}, _row, {});
+    vtout.ls0();
+}
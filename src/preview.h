@@ -0,0 +1,56 @@
+// VT Font Maker
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#pragma once
+
+#include <chrono>
+#include <optional>
+#include <string>
+#include <vector>
+
+class capabilities;
+class glyph_manager;
+
+class preview_font {
+public:
+    preview_font(glyph_manager& glyphs);
+    ~preview_font();
+    void load();
+    void update();
+    std::optional<int> upload_delay() const;
+    void upload();
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    void _upload(const int first_index, const int last_index, const int erase);
+
+    static constexpr auto debounce_delay = std::chrono::milliseconds{250};
+    static constexpr auto max_upload_delay = std::chrono::milliseconds{1000};
+    glyph_manager& _glyphs;
+    bool _loaded = false;
+    int _revision = 0;
+    std::optional<clock::time_point> _first_change;
+    clock::time_point _last_change;
+    std::string _layout;
+    std::vector<std::string> _uploaded;
+};
+
+class sample_text {
+public:
+    sample_text(const capabilities& caps, preview_font& font);
+    bool visible() const;
+    void toggle();
+    void edit();
+    void render();
+
+private:
+    void _erase();
+
+    preview_font& _font;
+    int _row;
+    int _width;
+    bool _visible = false;
+    std::string _text = "The quick brown fox jumps over the lazy dog 0123456789";
+};
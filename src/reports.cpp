@@ -0,0 +1,109 @@
+// VT Font Maker
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#include "reports.h"
+
+bool report::is(const type t, const char prefix, const std::string_view intermediates, const char final) const
+{
+    return kind == t && this->prefix == prefix && this->intermediates == intermediates && this->final == final;
+}
+
+int report::parm(const int index) const
+{
+    return index >= 0 && index < std::ssize(parms) ? parms[index] : 0;
+}
+
+std::string report::str() const
+{
+    auto s = std::string{};
+    if (prefix) s += prefix;
+    for (auto i = std::size_t{0}; i < parms.size(); i++) {
+        if (i > 0) s += ';';
+        s += std::to_string(parms[i]);
+    }
+    s += intermediates;
+    s += final;
+    return s;
+}
+
+std::optional<report> report_parser::parse(const char ch)
+{
+    // Ignore XON, XOFF
+    if (ch == '\021' || ch == '\023')
+        return {};
+    // CAN and SUB abort the current sequence.
+    if (ch == '\030' || ch == '\032') {
+        _state = state::ground;
+        return {};
+    }
+    switch (_state) {
+        case state::ground:
+            if (ch == '\033') _state = state::escape;
+            return {};
+        case state::escape:
+            _report = {};
+            switch (ch) {
+                case '[':
+                    _report.kind = report::type::csi;
+                    _state = state::parameters;
+                    break;
+                case 'P':
+                    _report.kind = report::type::dcs;
+                    _state = state::parameters;
+                    break;
+                case ']':
+                    _report.kind = report::type::osc;
+                    _state = state::string;
+                    break;
+                case '\033':
+                    break;
+                default:
+                    _state = state::ground;
+                    break;
+            }
+            return {};
+        case state::parameters:
+            if (ch >= '0' && ch <= '9') {
+                if (_report.parms.empty()) _report.parms.push_back(0);
+                _report.parms.back() = _report.parms.back() * 10 + (ch - '0');
+            } else if (ch == ';' || ch == ',') {
+                // The Reflection Desktop terminal sometimes uses comma
+                // separators instead of semicolons, so we allow for either.
+                if (_report.parms.empty()) _report.parms.push_back(0);
+                _report.parms.push_back(0);
+            } else if (ch >= '<' && ch <= '?') {
+                _report.prefix = ch;
+            } else if (ch >= ' ' && ch <= '/') {
+                _report.intermediates += ch;
+            } else if (ch >= '@' && ch <= '~') {
+                _report.final = ch;
+                if (_report.kind == report::type::csi) {
+                    _state = state::ground;
+                    return std::move(_report);
+                }
+                _state = state::string;
+            } else if (ch == '\033') {
+                _state = state::escape;
+            }
+            return {};
+        case state::string:
+            if (ch == '\033')
+                _state = state::string_escape;
+            else if (ch == '\007' && _report.kind == report::type::osc) {
+                _state = state::ground;
+                return std::move(_report);
+            } else
+                _report.data += ch;
+            return {};
+        case state::string_escape:
+            if (ch == '\\') {
+                _state = state::ground;
+                return std::move(_report);
+            }
+            // Anything other than ST starts a new sequence.
+            _state = state::escape;
+            return parse(ch);
+    }
+    return {};
+}
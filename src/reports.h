@@ -0,0 +1,47 @@
+// VT Font Maker
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#pragma once
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class report {
+public:
+    enum class type {
+        csi,
+        dcs,
+        osc
+    };
+
+    bool is(const type t, const char prefix, const std::string_view intermediates, const char final) const;
+    int parm(const int index) const;
+    std::string str() const;
+
+    type kind = type::csi;
+    char prefix = 0;
+    std::vector<int> parms;
+    std::string intermediates;
+    char final = 0;
+    std::string data;
+};
+
+class report_parser {
+public:
+    std::optional<report> parse(const char ch);
+
+private:
+    enum class state {
+        ground,
+        escape,
+        parameters,
+        string,
+        string_escape
+    };
+
+    state _state = state::ground;
+    report _report;
+};
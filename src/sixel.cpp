@@ -0,0 +1,89 @@
+// VT Font Maker
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#include "sixel.h"
+
+#include <algorithm>
+#include <set>
+
+namespace {
+
+    void append_run(std::string& s, const char sixel, const int count)
+    {
+        // Runs of more than three sixels are shorter with a repeat count.
+        if (count > 3)
+            s += '!' + std::to_string(count) + sixel;
+        else
+            s.append(count, sixel);
+    }
+
+}  // namespace
+
+sixel_image::sixel_image(const int width, const int height)
+    : _width{width}, _height{height}, _pixels(width * height)
+{
+}
+
+void sixel_image::define_color(const int index, const std::string_view definition)
+{
+    _color_definitions[index] = definition;
+}
+
+void sixel_image::set(const int x, const int y, const int color)
+{
+    _pixels[y * _width + x] = color;
+}
+
+std::string sixel_image::str() const
+{
+    // We set every pixel in the image, so the background select is 1, and
+    // the raster attributes give us a 1:1 aspect ratio and the image size.
+    auto s = "0;1;0q\"1;1;" + std::to_string(_width) + ';' + std::to_string(_height);
+    auto colors_used = std::set<int>{_pixels.begin(), _pixels.end()};
+    for (const auto& [index, definition] : _color_definitions)
+        if (colors_used.contains(index))
+            s += '#' + std::to_string(index) + ';' + definition;
+    const auto band_count = (_height + 5) / 6;
+    for (auto band = 0; band < band_count; band++) {
+        if (band > 0) s += '-';
+        _encode_band(s, band);
+    }
+    return s;
+}
+
+void sixel_image::_encode_band(std::string& s, const int band) const
+{
+    const auto first_row = band * 6;
+    const auto row_count = std::min(_height - first_row, 6);
+    auto colors_used = std::set<int>{};
+    for (auto y = first_row; y < first_row + row_count; y++)
+        for (auto x = 0; x < _width; x++)
+            colors_used.insert(_pixels[y * _width + x]);
+    // Each color is written as a separate pass over the band, with a graphics
+    // carriage return between them.
+    auto first_color = true;
+    for (const auto color : colors_used) {
+        if (!first_color) s += '$';
+        first_color = false;
+        s += '#' + std::to_string(color);
+        auto run_sixel = '?';
+        auto run_length = 0;
+        for (auto x = 0; x < _width; x++) {
+            auto bits = 0;
+            for (auto i = 0; i < row_count; i++)
+                if (_pixels[(first_row + i) * _width + x] == color)
+                    bits |= 1 << i;
+            const auto sixel = static_cast<char>('?' + bits);
+            if (sixel != run_sixel && run_length > 0) {
+                append_run(s, run_sixel, run_length);
+                run_length = 0;
+            }
+            run_sixel = sixel;
+            run_length++;
+        }
+        // There's no need to write out trailing blank sixels.
+        if (run_sixel != '?')
+            append_run(s, run_sixel, run_length);
+    }
+}
@@ -0,0 +1,27 @@
+// VT Font Maker
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class sixel_image {
+public:
+    sixel_image(const int width, const int height);
+    void define_color(const int index, const std::string_view definition);
+    void set(const int x, const int y, const int color);
+    std::string str() const;
+
+private:
+    void _encode_band(std::string& s, const int band) const;
+
+    int _width;
+    int _height;
+    std::vector<uint8_t> _pixels;
+    std::map<int, std::string> _color_definitions;
+};
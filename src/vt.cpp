@@ -332,10 +332,16 @@ void vt_stream::flush()
     if (_buffer_index) {
         _stream.write(&_buffer[0], _buffer_index);
         _stream.flush();
+        _bytes_flushed += _buffer_index;
         _buffer_index = 0;
     }
 }
 
+std::size_t vt_stream::bytes_written() const
+{
+    return _bytes_flushed + _buffer_index;
+}
+
 void vt_stream::_csi()
 {
     _string("\033[");
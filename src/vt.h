@@ -5,6 +5,7 @@
 #pragma once
 
 #include <array>
+#include <cstddef>
 #include <initializer_list>
 #include <iostream>
 #include <string_view>
@@ -65,6 +66,7 @@ public:
     void write(const wchar_t ch);
     void write_spaces(const int count);
     void flush();
+    std::size_t bytes_written() const;
 
 private:
     void _csi();
@@ -78,6 +80,7 @@ private:
     std::ostream& _stream;
     std::array<char, 8192> _buffer = {};
     int _buffer_index = 0;
+    std::size_t _bytes_flushed = 0;
 };
 
 extern vt_stream vtout;
@@ -0,0 +1,147 @@
+// VT Font Maker
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#include "harness.h"
+#include "session.h"
+
+#include "keyboard.h"
+#include "vt.h"
+
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+    // These are full cell fonts for each of the devices in the New dialog,
+    // other than the VT2x0, which only supports text usage at 80x24.
+    const auto devices = std::map<std::string, std::vector<int>>{
+        {"vt5xx", {0, 0, 0, 10, 0, 2, 16, 0}},
+        {"vt382", {0, 0, 0, 12, 0, 2, 30, 0}},
+        {"vt340", {0, 0, 0, 10, 0, 2, 20, 0}},
+        {"vt320", {0, 0, 0, 15, 0, 2, 12, 0}},
+        {"vt2x0", {0, 0, 0, 4, 0, 0}},
+        {"custom", {0, 0, 0, 16, 0, 2, 32, 0}},
+    };
+
+    using operation = std::pair<std::string, std::function<void(canvas&)>>;
+
+    const auto operations = std::vector<operation>{
+        {"load", [](auto& c) { c.refresh(); }},
+        {"move", [](auto& c) {
+             for (const auto k : {key::right, key::down, key::left, key::up, key::right})
+                 c.process_key(k);
+         }},
+        {"select", [](auto& c) {
+             for (const auto k : {key::alt + key::right, key::alt + key::right, key::alt + key::down, key::alt + key::down})
+                 c.process_key(k);
+         }},
+        {"invert", [](auto& c) { c.invert(); }},
+        {"flip", [](auto& c) { c.flip_horizontally(); }},
+        {"paste", [](auto& c) {
+             c.copy_selection();
+             c.process_key(key::down);
+             c.process_key(key::down);
+             c.process_key(key::down);
+             c.paste();
+         }},
+        {"undo", [](auto& c) { c.undo(); }},
+        {"toggle_double_width", [](auto& c) { c.toggle_double_width(); }},
+        {"toggle_reverse_screen", [](auto& c) { c.toggle_reverse_screen(); }},
+    };
+
+    std::map<std::string, std::size_t> load_budgets(const std::string& path, const std::string& device)
+    {
+        // Each line is a device name, an operation name, and the maximum
+        // number of bytes the operation may emit. Blank lines and comments
+        // starting with # are ignored.
+        auto budgets = std::map<std::string, std::size_t>{};
+        auto file = std::ifstream{path};
+        auto line = std::string{};
+        while (std::getline(file, line)) {
+            if (line.empty() || line.starts_with("#")) continue;
+            auto fields = std::istringstream{line};
+            auto line_device = std::string{};
+            auto name = std::string{};
+            auto bytes = std::size_t{0};
+            if (fields >> line_device >> name >> bytes && line_device == device)
+                budgets[name] = bytes;
+        }
+        return budgets;
+    }
+
+}  // namespace
+
+int main(int argc, const char* argv[])
+{
+    if (argc < 3 || !devices.contains(argv[2])) {
+        std::cerr << "Usage: budget_test BUDGET_FILE DEVICE [--record]\n";
+        return 2;
+    }
+    const auto budget_path = std::string{argv[1]};
+    const auto device = std::string{argv[2]};
+    const auto record = argc > 3 && std::string{argv[3]} == "--record";
+    const auto budgets = load_budgets(budget_path, device);
+
+    auto harness = terminal_harness{};
+    auto session = editor_session{harness, devices.at(device)};
+    auto& edit_canvas = session.edit_canvas();
+    const auto check_budget = [&](const std::string& name, const std::size_t bytes) {
+        // In record mode the results are written out in the budget file
+        // format, so the file can be regenerated after an intended change.
+        // Note that stdout is connected to the emulator, so we use stderr.
+        if (record) {
+            std::clog << device << " " << name << " " << bytes << "\n";
+            return;
+        }
+        const auto budget = budgets.find(name);
+        if (budget == budgets.end()) {
+            std::cerr << device << " " << name << ": " << bytes << " bytes, no budget\n";
+            CHECK(budget != budgets.end());
+        } else {
+            std::cerr << device << " " << name << ": " << bytes << " bytes, budget " << budget->second << "\n";
+            CHECK(bytes <= budget->second);
+        }
+    };
+
+    // The startup covers everything from the capabilities probe up to the
+    // initial render of the canvas wallpaper.
+    vtout.flush();
+    CHECK(vtout.bytes_written() == harness.terminal().bytes_received());
+    check_budget("startup", vtout.bytes_written());
+
+    for (const auto& [name, action] : operations) {
+        const auto bytes = session.measure([&] { action(edit_canvas); });
+        session.idle();
+        check_budget(name, bytes);
+    }
+
+    // The incremental updates should leave the screen exactly as a full
+    // render would have drawn it. The focus is moved back to the origin
+    // first, since that's where the refresh will leave it.
+    session.measure([&] {
+        for (auto i = 0; i < 32; i++) {
+            edit_canvas.process_key(key::up);
+            edit_canvas.process_key(key::left);
+        }
+    });
+    const auto& vt = harness.terminal();
+    auto incremental = std::vector<vt525::cell>{};
+    for (auto row = 1; row <= vt.height(); row++)
+        for (auto col = 1; col <= vt.width(); col++)
+            incremental.push_back(vt.at(1, row, col));
+    session.measure([&] { edit_canvas.refresh(); });
+    auto mismatches = 0;
+    for (auto row = 1, i = 0; row <= vt.height(); row++)
+        for (auto col = 1; col <= vt.width(); col++)
+            if (vt.at(1, row, col) != incremental[i++]) mismatches++;
+    CHECK(mismatches == 0);
+
+    return test::report("budget_test " + device);
+}
@@ -0,0 +1,175 @@
+// VT Font Maker
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#include "harness.h"
+
+#include "canvas.h"
+#include "capabilities.h"
+#include "coloring.h"
+#include "dialog.h"
+#include "font.h"
+#include "glyphs.h"
+#include "keyboard.h"
+#include "macros.h"
+#include "os.h"
+#include "status.h"
+#include "vt.h"
+
+#include <fstream>
+
+namespace {
+
+    void test_parser()
+    {
+        auto vt = vt525{};
+        vt.write("\033[3;5HHello\033[1;7mX\033[m");
+        CHECK(vt.text(1, 3).substr(4, 6) == "HelloX");
+        CHECK(vt.at(1, 3, 10).attrs.bold && vt.at(1, 3, 10).attrs.reverse);
+        CHECK(!vt.at(1, 3, 9).attrs.bold);
+        CHECK(vt.sequence_count("CUP") == 1);
+        CHECK(vt.sequence_count("SGR") == 2);
+
+        // Rectangular area operations, with origin mode and margins.
+        vt.write("\033[?69;6h\033[5;10s\033[2;4r");
+        vt.write("\033[42;1;1;2;3$x");
+        CHECK(vt.text(1, 2).substr(4, 3) == "***");
+        CHECK(vt.text(1, 3).substr(4, 3) == "***");
+        CHECK(vt.at(1, 4, 5).ch == ' ');
+        vt.write("\033[1;1;2;3;1;1;1;3$v");
+        CHECK(vt.text(3, 2).substr(4, 3) == "***");
+        vt.write("\033[1;1;1;1;4$r");
+        CHECK(vt.at(1, 2, 5).attrs.underline);
+        CHECK(!vt.at(1, 2, 6).attrs.underline);
+        vt.write("\033[?69;6l\033[r");
+
+        // Macros, hex encoded with repeats, and invoked from another macro.
+        vt.write("\033P1;0;1!z!3;41;42\033\\");
+        vt.write("\033P2;0;1!z1B5B31303B31481B5B312A7A\033\\");
+        vt.write("\033[2*z");
+        CHECK(vt.text(1, 10).substr(0, 4) == "AAAB");
+        CHECK(vt.macro_count() == 2);
+        CHECK(vt.sequence_count("CUP") == 1);
+        CHECK(vt.sequence_count("DECINVM") == 1);
+        vt.write("\033P0;1;0!z\033\\");
+        CHECK(vt.macro_count() == 0);
+
+        // Soft fonts and character set designation.
+        vt.write("\033P0;33;1;10;0;2;16;0{ @??~~/@@;NN\033\\");
+        CHECK(vt.glyph(" @", 33) == "??~~/@@");
+        CHECK(vt.glyph(" @", 34) == "NN");
+        vt.write("\033) @\016!\017!");
+        CHECK(vt.at(1, 10, 5).charset == " @");
+        CHECK(vt.at(1, 10, 6).charset == "B");
+
+        // Sixel images are decoded with their position.
+        vt.write("\033[12;3H\033P0;1;0q\"1;1;4;7#1;2;0;0;0#2;2;100;100;100#1!4~-#2@$#1?@\033\\");
+        CHECK(vt.images().size() == 1);
+        const auto& img = vt.images().back();
+        CHECK(img.row == 12 && img.col == 3);
+        CHECK(img.width == 4 && img.height == 7);
+        CHECK(img.at(0, 0) == 1 && img.at(3, 5) == 1);
+        CHECK(img.at(0, 6) == 2 && img.at(1, 6) == 1 && img.at(2, 6) == -1);
+
+        // Reports.
+        vt.write("\033[c\033[5;7H\033[6n\033[?62n\033[?112$p");
+        CHECK(vt.take_replies() == "\033[?65;1;2;7;8;9;12;18;19;21;22;23;24;28;29;32;42;44;45;46c\033[5;7R\033[512*{\033[?112;2$y");
+    }
+
+    void test_startup()
+    {
+        auto options = vt525::options{};
+        options.width = 132;
+        options.height = 36;
+        options.page_count = 4;
+        options.macro_space = 4096;
+        auto harness = terminal_harness{options};
+        auto& vt = harness.terminal();
+
+        // On a first run, every probe is sent in a single burst.
+        auto caps = capabilities{};
+        CHECK(harness.flush_count() == 1);
+        CHECK(caps.width == 132 && caps.height == 36);
+        CHECK(caps.page_count == 4 && caps.has_pages);
+        CHECK(caps.macro_space == 4096);
+        CHECK(caps.has_soft_fonts && caps.has_rectangle_ops && caps.has_macros);
+        CHECK(caps.has_color && caps.has_horizontal_scrolling);
+        CHECK(!caps.has_sixel);
+        CHECK(caps.has_pc_keyboard);
+        CHECK(caps.color_table == vt.color_table());
+
+        const auto font = soft_font{};
+        const auto colors = coloring{caps};
+        macro_manager::initialize(caps);
+        dialog::initialize(caps);
+        keyboard::initialize(caps);
+        vtout.flush();
+        CHECK(!vt.glyph(" @", soft_font::quadrant_base - 32).value_or("").empty());
+        CHECK(vt.color_table() != caps.color_table);
+
+        auto status_bar = status{caps};
+        auto glyphs = glyph_manager{};
+        auto edit_canvas = canvas{caps, glyphs, status_bar};
+        edit_canvas.render();
+        edit_canvas.flush();
+        vtout.flush();
+        CHECK(vt.macro_space_used() <= options.macro_space);
+        // The grid is drawn using the application font.
+        auto grid_cells = 0;
+        for (auto row = 1; row <= vt.height(); row++)
+            for (auto col = 1; col <= vt.width(); col++)
+                if (vt.at(1, row, col).charset == " @") grid_cells++;
+        CHECK(grid_cells > 100);
+        harness.discard_input();
+    }
+
+    void test_capability_cache()
+    {
+        auto harness = terminal_harness{};
+        auto& vt = harness.terminal();
+        {
+            const auto caps = capabilities{};
+            CHECK(caps.macro_space == 8192);
+        }
+        // The second probe should load the static capabilities from the
+        // cache, but the modes and colors could have changed since then.
+        vt.write("\033[?64h\033P2$p3;2;10;20;30\033\\");
+        vt.take_replies();
+        vt.reset_counts();
+        {
+            const auto flushes = harness.flush_count();
+            const auto caps = capabilities{};
+            CHECK(harness.flush_count() == flushes + 1);
+            CHECK(caps.macro_space == 8192);
+            CHECK(caps.page_count == 6);
+            CHECK(caps.color_table == vt.color_table());
+            CHECK(caps.color_table.find("3;2;10;20;30") != std::string::npos);
+            CHECK(vt.sequence_count("DECRQM") == 2);
+            CHECK(vt.sequence_count("DECCTR") == 1);
+            CHECK(vt.sequence_count("DECDMAC") == 0);
+            CHECK(vt.sequence_count("DSR") == 1);
+        }
+        // A terminal that isn't in the cache needs a second round trip for
+        // the static capabilities.
+        {
+            std::ofstream{os::cache_path() / "capabilities"} << "da=\033[?1c page_count=2 pc_keyboard=0 macro_space=0\n";
+            const auto flushes = harness.flush_count();
+            const auto caps = capabilities{};
+            CHECK(harness.flush_count() == flushes + 2);
+            CHECK(caps.macro_space == 8192);
+            CHECK(caps.page_count == 6);
+        }
+        vt.write("\033[?64$p");
+        CHECK(vt.take_replies() == "\033[?64;1$y");
+        harness.discard_input();
+    }
+
+}  // namespace
+
+int main()
+{
+    test_parser();
+    test_startup();
+    test_capability_cache();
+    return test::report("emulator_test");
+}
@@ -0,0 +1,133 @@
+// VT Font Maker
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#include "harness.h"
+
+#include "vt.h"
+
+#include <poll.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+namespace {
+
+    int failure_count = 0;
+    int check_count = 0;
+
+}  // namespace
+
+void test::check(const bool condition, const std::string_view expression, const std::string_view file, const int line)
+{
+    check_count++;
+    if (!condition) {
+        failure_count++;
+        std::cerr << file << ":" << line << ": check failed: " << expression << "\n";
+    }
+}
+
+int test::report(const std::string_view name)
+{
+    std::cerr << name << ": " << check_count - failure_count << "/" << check_count << " checks passed\n";
+    return failure_count ? 1 : 0;
+}
+
+terminal_harness::output_buffer::output_buffer(terminal_harness& harness)
+    : _harness{harness}
+{
+}
+
+terminal_harness::output_buffer::int_type terminal_harness::output_buffer::overflow(int_type ch)
+{
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+        const auto c = traits_type::to_char_type(ch);
+        _harness._write({&c, 1});
+    }
+    return traits_type::not_eof(ch);
+}
+
+std::streamsize terminal_harness::output_buffer::xsputn(const char* s, std::streamsize count)
+{
+    _harness._write({s, std::size_t(count)});
+    return count;
+}
+
+int terminal_harness::output_buffer::sync()
+{
+    // Every flush of vtout ends up here, so it's a measure of how many times
+    // the application has waited on the terminal.
+    _harness._flush_count++;
+    return 0;
+}
+
+terminal_harness::terminal_harness(const vt525::options& options)
+    : _terminal{options}, _buffer{*this}
+{
+    vtout.flush();
+    _original_buffer = std::cout.rdbuf(&_buffer);
+    if (pipe(_input_pipe) == 0) {
+        _original_stdin = dup(STDIN_FILENO);
+        dup2(_input_pipe[0], STDIN_FILENO);
+    }
+    _cache_path = std::filesystem::temp_directory_path();
+    _cache_path.append("vtfontmaker-test-" + std::to_string(getpid()));
+    std::filesystem::create_directories(_cache_path);
+    setenv("XDG_CACHE_HOME", _cache_path.c_str(), 1);
+}
+
+terminal_harness::~terminal_harness()
+{
+    vtout.flush();
+    std::cout.rdbuf(_original_buffer);
+    if (_original_stdin >= 0) {
+        dup2(_original_stdin, STDIN_FILENO);
+        close(_original_stdin);
+    }
+    for (const auto fd : _input_pipe)
+        if (fd >= 0) close(fd);
+    auto error = std::error_code{};
+    std::filesystem::remove_all(_cache_path, error);
+}
+
+vt525& terminal_harness::terminal()
+{
+    return _terminal;
+}
+
+int terminal_harness::flush_count() const
+{
+    return _flush_count;
+}
+
+void terminal_harness::type(const std::string_view keys)
+{
+    _send(keys);
+}
+
+void terminal_harness::discard_input()
+{
+    // Anything the application didn't read, such as an unexpected report,
+    // is dropped so it can't be mistaken for a key press later.
+    auto fds = pollfd{STDIN_FILENO, POLLIN, 0};
+    char buffer[256];
+    while (poll(&fds, 1, 0) > 0 && read(STDIN_FILENO, buffer, sizeof(buffer)) > 0) {
+    }
+}
+
+void terminal_harness::_write(const std::string_view data)
+{
+    _terminal.write(data);
+    _send(_terminal.take_replies());
+}
+
+void terminal_harness::_send(const std::string_view data)
+{
+    for (auto remaining = data; !remaining.empty();) {
+        const auto written = ::write(_input_pipe[1], remaining.data(), remaining.length());
+        if (written <= 0) break;
+        remaining.remove_prefix(written);
+    }
+}
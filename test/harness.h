@@ -0,0 +1,61 @@
+// VT Font Maker
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#pragma once
+
+#include "vt525.h"
+
+#include <filesystem>
+#include <memory>
+#include <streambuf>
+#include <string_view>
+
+namespace test {
+
+    void check(const bool condition, const std::string_view expression, const std::string_view file, const int line);
+    int report(const std::string_view name);
+
+}  // namespace test
+
+#define CHECK(condition) test::check((condition), #condition, __FILE__, __LINE__)
+
+// This connects the application's I/O to an in-process vt525. Everything
+// written to vtout is fed to the emulator, and the emulator's replies, along
+// with any typed keys, are passed back through a pipe attached to stdin, so
+// os::getch sees them exactly as it would from a real terminal. The cache
+// directory is also redirected, so the capabilities probe always runs.
+class terminal_harness {
+public:
+    terminal_harness(const vt525::options& options = {});
+    ~terminal_harness();
+    vt525& terminal();
+    int flush_count() const;
+    void type(const std::string_view keys);
+    void discard_input();
+
+private:
+    class output_buffer : public std::streambuf {
+    public:
+        output_buffer(terminal_harness& harness);
+
+    protected:
+        int_type overflow(int_type ch) override;
+        std::streamsize xsputn(const char* s, std::streamsize count) override;
+        int sync() override;
+
+    private:
+        terminal_harness& _harness;
+    };
+
+    void _write(const std::string_view data);
+    void _send(const std::string_view data);
+
+    vt525 _terminal;
+    output_buffer _buffer;
+    std::streambuf* _original_buffer;
+    int _input_pipe[2] = {-1, -1};
+    int _original_stdin = -1;
+    int _flush_count = 0;
+    std::filesystem::path _cache_path;
+};
@@ -0,0 +1,75 @@
+// VT Font Maker
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#include "harness.h"
+#include "session.h"
+
+#include "bitboard.h"
+#include "glyphs.h"
+
+#include <cstdint>
+#include <vector>
+
+// This applies two batch transforms with overlapping glyph ranges, and checks
+// that undoing the first batch also undoes the whole of the second, and that
+// both can then be redone.
+int main()
+{
+    auto harness = terminal_harness{};
+    auto session = editor_session{harness, {0, 0, 0, 10, 0, 2, 20, 0}};
+    auto& glyphs = session.glyphs();
+    auto& edit_canvas = session.edit_canvas();
+
+    const auto capture = [&] {
+        auto state = std::vector<std::vector<int8_t>>{};
+        for (auto index = 2; index <= 6; index++)
+            state.push_back(std::vector<int8_t>(glyphs[index]));
+        return state;
+    };
+    const auto invert = [](bitboard& board) { board.invert(); };
+
+    // The first batch covers glyphs 2 to 4, and is applied from glyph 2. The
+    // second covers glyphs 3 to 5, and is applied from glyph 6, which is not
+    // in the batch itself.
+    const auto original = capture();
+    session.measure([&] {
+        edit_canvas.refresh();
+        edit_canvas.select_char(2);
+        edit_canvas.transform_glyphs(2, 4, invert);
+    });
+    const auto first_batch = capture();
+    CHECK(first_batch != original);
+    session.measure([&] {
+        edit_canvas.select_char(6);
+        edit_canvas.transform_glyphs(3, 5, invert);
+    });
+    const auto second_batch = capture();
+    CHECK(second_batch != first_batch);
+
+    // Undoing the first batch has to undo the second batch everywhere too,
+    // including glyph 5, which the first batch never touched.
+    session.measure([&] {
+        edit_canvas.select_char(2);
+        edit_canvas.undo();
+    });
+    CHECK(capture() == original);
+    CHECK(!edit_canvas.can_undo());
+
+    // Redoing it from the same glyph only redoes the first batch, and the
+    // second can then be redone from the glyph it was applied from.
+    session.measure([&] { edit_canvas.redo(); });
+    CHECK(capture() == first_batch);
+    session.measure([&] {
+        edit_canvas.select_char(6);
+        edit_canvas.redo();
+    });
+    CHECK(capture() == second_batch);
+
+    // And undoing the second batch on its own leaves the first in place.
+    session.measure([&] { edit_canvas.undo(); });
+    CHECK(capture() == first_batch);
+
+    harness.discard_input();
+    return test::report("history_test");
+}
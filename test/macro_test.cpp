@@ -0,0 +1,64 @@
+// VT Font Maker
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#include "harness.h"
+#include "session.h"
+
+#include "keyboard.h"
+#include "vt.h"
+
+#include <vector>
+
+// This runs the editor on a terminal with very little macro space, so most
+// of the macros have to be evicted and reloaded, or sent directly, and then
+// checks that the screen is still rendered correctly.
+int main()
+{
+    auto options = vt525::options{};
+    options.macro_space = 256;
+    auto harness = terminal_harness{options};
+    const auto& vt = harness.terminal();
+    auto session = editor_session{harness, {0, 0, 0, 10, 0, 2, 20, 0}};
+    auto& edit_canvas = session.edit_canvas();
+    CHECK(session.caps().macro_space == options.macro_space);
+
+    const auto keys = {
+        key::right, key::down, key::alt + key::right, key::alt + key::down,
+        key::space, key::down, key::down, key::space, key::left};
+    session.measure([&] { edit_canvas.refresh(); });
+    for (auto i = 0; i < 3; i++) {
+        session.measure([&] {
+            for (const auto k : keys)
+                edit_canvas.process_key(k);
+            edit_canvas.invert();
+            edit_canvas.toggle_reverse_screen();
+        });
+        session.idle();
+        CHECK(vt.macro_space_used() <= options.macro_space);
+        CHECK(vt.undefined_macro_invocations() == 0);
+    }
+    session.measure([&] { edit_canvas.toggle_double_width(); });
+
+    // The same screen should be drawn from scratch after a refresh, once
+    // the focus has been moved back to the origin.
+    session.measure([&] {
+        for (auto i = 0; i < 32; i++) {
+            edit_canvas.process_key(key::up);
+            edit_canvas.process_key(key::left);
+        }
+    });
+    auto incremental = std::vector<vt525::cell>{};
+    for (auto row = 1; row <= vt.height(); row++)
+        for (auto col = 1; col <= vt.width(); col++)
+            incremental.push_back(vt.at(1, row, col));
+    session.measure([&] { edit_canvas.refresh(); });
+    auto mismatches = 0;
+    for (auto row = 1, i = 0; row <= vt.height(); row++)
+        for (auto col = 1; col <= vt.width(); col++)
+            if (vt.at(1, row, col) != incremental[i++]) mismatches++;
+    CHECK(mismatches == 0);
+    CHECK(vt.undefined_macro_invocations() == 0);
+
+    return test::report("macro_test");
+}
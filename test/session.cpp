@@ -0,0 +1,83 @@
+// VT Font Maker
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#include "session.h"
+
+#include "dialog.h"
+#include "harness.h"
+#include "keyboard.h"
+#include "macros.h"
+#include "vt.h"
+
+editor_session::editor_session(terminal_harness& harness, const std::vector<int>& font_params)
+    : _harness{harness}, _colors{_caps}
+{
+    // These are the modes that main sets up before the UI starts.
+    vtout.sgr();
+    vtout.ed(2);
+    vtout.rm('?', {25, 7});
+    vtout.sm('?', {69, 6});
+    vtout.decsace(2);
+    macro_manager::initialize(_caps);
+    dialog::initialize(_caps);
+    keyboard::initialize(_caps);
+    _status = std::make_unique<status>(_caps);
+    _glyphs = std::make_unique<glyph_manager>();
+    _glyphs->clear(font_params, " @");
+    // A few glyphs are filled with a fixed pattern, so there is something
+    // on the canvas other than blank pixels.
+    const auto width = _glyphs->cell_width();
+    const auto height = _glyphs->cell_height();
+    const auto first_index = _glyphs->first_used();
+    for (auto index = first_index; index < first_index + 8; index++) {
+        auto pixels = std::vector<int8_t>(width * height);
+        for (auto y = 0; y < height; y++)
+            for (auto x = 0; x < width; x++)
+                pixels[y * width + x] = (x * y + index) % 3 == 0;
+        (*_glyphs)[index] = pixels;
+    }
+    _canvas = std::make_unique<canvas>(_caps, *_glyphs, *_status);
+    _canvas->render();
+    _status->render();
+    vtout.flush();
+    _harness.discard_input();
+}
+
+capabilities& editor_session::caps()
+{
+    return _caps;
+}
+
+glyph_manager& editor_session::glyphs()
+{
+    return *_glyphs;
+}
+
+canvas& editor_session::edit_canvas()
+{
+    return *_canvas;
+}
+
+std::size_t editor_session::measure(const std::function<void()>& operation)
+{
+    // The operation is measured up to the point where the screen is fully
+    // updated, which includes any rows that were deferred by the renderer.
+    vtout.flush();
+    const auto start = _harness.terminal().bytes_received();
+    operation();
+    _canvas->flush();
+    while (_canvas->resume_render()) {
+    }
+    vtout.flush();
+    return _harness.terminal().bytes_received() - start;
+}
+
+void editor_session::idle()
+{
+    // This is the background work the application performs while it's
+    // waiting for input.
+    while (macro_manager::upload_pending() || _canvas->prefetch()) {
+    }
+    vtout.flush();
+}
@@ -0,0 +1,41 @@
+// VT Font Maker
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#pragma once
+
+#include "canvas.h"
+#include "capabilities.h"
+#include "coloring.h"
+#include "font.h"
+#include "glyphs.h"
+#include "status.h"
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+class terminal_harness;
+
+// This goes through the same startup sequence as main, and then sets up a
+// canvas editing a font with the given parameters, so tests can drive the
+// canvas operations directly.
+class editor_session {
+public:
+    editor_session(terminal_harness& harness, const std::vector<int>& font_params);
+    capabilities& caps();
+    glyph_manager& glyphs();
+    canvas& edit_canvas();
+    std::size_t measure(const std::function<void()>& operation);
+    void idle();
+
+private:
+    terminal_harness& _harness;
+    capabilities _caps;
+    soft_font _font;
+    coloring _colors;
+    std::unique_ptr<status> _status;
+    std::unique_ptr<glyph_manager> _glyphs;
+    std::unique_ptr<canvas> _canvas;
+};
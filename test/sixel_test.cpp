@@ -0,0 +1,118 @@
+// VT Font Maker
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#include "harness.h"
+#include "session.h"
+
+#include "glyphs.h"
+#include "keyboard.h"
+#include "vt.h"
+
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+// This runs the editor in the sixel view, and decodes the images it sends,
+// to check that each edit is drawn with a single image, and that the images
+// combined still match the glyph being edited.
+int main()
+{
+    auto options = vt525::options{};
+    options.has_sixel = true;
+    auto harness = terminal_harness{options};
+    auto& vt = harness.terminal();
+    auto session = editor_session{harness, {0, 0, 0, 10, 0, 2, 20, 0}};
+    auto& glyphs = session.glyphs();
+    auto& edit_canvas = session.edit_canvas();
+    CHECK(session.caps().has_sixel);
+
+    // The decoded images are drawn onto a map of the screen pixels, so the
+    // partial updates can be combined with the initial full image.
+    auto screen = std::map<std::pair<int, int>, int>{};
+    const auto draw_images = [&] {
+        for (const auto& image : vt.images()) {
+            const auto top = (image.row - 1) * vt525::sixel_cell_height;
+            const auto left = (image.col - 1) * vt525::sixel_cell_width;
+            for (auto y = 0; y < image.height; y++)
+                for (auto x = 0; x < image.width; x++)
+                    screen[{top + y, left + x}] = image.at(x, y);
+        }
+        vt.clear_images();
+    };
+
+    // One of the glyphs with a fill pattern is selected, so the images have
+    // something to show other than the grid.
+    const auto index = 2;
+    session.measure([&] {
+        edit_canvas.refresh();
+        edit_canvas.select_char(index);
+    });
+    vt.clear_images();
+    session.measure([&] { edit_canvas.toggle_sixel_view(); });
+    CHECK(vt.images().size() == 1);
+    if (vt.images().size() != 1) return test::report("sixel_test");
+    const auto full = vt.images().front();
+    draw_images();
+
+    // The test font is drawn with a whole number of image rows and columns
+    // for every pixel, so the mapping is easy to reverse.
+    const auto cell_width = glyphs.cell_width();
+    const auto cell_height = glyphs.cell_height();
+    CHECK(full.width % cell_width == 0);
+    CHECK(full.height % cell_height == 0);
+    const auto pixel_width = full.width / cell_width;
+    const auto pixel_height = full.height / cell_height;
+    const auto canvas_top = (full.row - 1) * vt525::sixel_cell_height;
+    const auto canvas_left = (full.col - 1) * vt525::sixel_cell_width;
+
+    // Set pixels are white, or light blue when focused, and the rest are
+    // a checkerboard of black and dark gray, which are shifted by two when
+    // focused.
+    const auto matches_glyph = [&] {
+        const auto pixels = std::vector<int8_t>(glyphs[index]);
+        auto mismatches = 0;
+        for (auto y = 0; y < full.height; y++) {
+            for (auto x = 0; x < full.width; x++) {
+                const auto gy = y / pixel_height;
+                const auto gx = x / pixel_width;
+                const auto color = screen[{canvas_top + y, canvas_left + x}];
+                const auto set = color == 7 || color == 5;
+                if (set != (pixels[gy * cell_width + gx] != 0))
+                    mismatches++;
+                else if (!set && color % 2 != (gx + gy) % 2)
+                    mismatches++;
+            }
+        }
+        return mismatches == 0;
+    };
+    CHECK(matches_glyph());
+
+    using operation = std::pair<std::string, std::function<void()>>;
+    const auto operations = std::vector<operation>{
+        {"toggle", [&] { edit_canvas.process_key(key::space); }},
+        {"move", [&] { edit_canvas.process_key(key::right); }},
+        {"select", [&] {
+             edit_canvas.process_key(key::alt + key::right);
+             edit_canvas.process_key(key::alt + key::down);
+         }},
+        {"fill", [&] { edit_canvas.process_key(key::space); }},
+        {"invert", [&] { edit_canvas.invert(); }},
+        {"undo", [&] { edit_canvas.undo(); }},
+        {"redo", [&] { edit_canvas.redo(); }},
+    };
+    for (const auto& [name, action] : operations) {
+        session.measure(action);
+        const auto image_count = vt.images().size();
+        draw_images();
+        std::cerr << name << ": " << image_count << " images\n";
+        CHECK(image_count == 1);
+        CHECK(matches_glyph());
+    }
+
+    return test::report("sixel_test");
+}
@@ -0,0 +1,898 @@
+// VT Font Maker
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#include "vt525.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <utility>
+
+namespace {
+
+    constexpr auto default_color_table =
+        "0;2;0;0;0/1;2;80;13;13/2;2;13;80;13/3;2;80;80;13/"
+        "4;2;13;13;80/5;2;80;13;80/6;2;13;80;80/7;2;80;80;80/"
+        "8;2;33;33;33/9;2;100;33;33/10;2;33;100;33/11;2;100;100;33/"
+        "12;2;33;33;100/13;2;100;33;100/14;2;33;100;100/15;2;100;100;100";
+
+    constexpr auto device_attributes = "\033[?65;1;2;7;8;9;12;18;19;21;22;23;24;28;29;32;42;44;45;46";
+
+    // These modes are reported as reset when they haven't been set, and
+    // anything else is reported as unrecognised.
+    constexpr auto known_private_modes = {6, 7, 25, 64, 69, 112};
+
+    int hex_value(const char ch)
+    {
+        if (ch >= '0' && ch <= '9') return ch - '0';
+        if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+        if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+        return -1;
+    }
+
+    std::string decode_hex(const std::string_view data)
+    {
+        // Hex encoded macros are pairs of hex digits, with !Pn;...; marking a
+        // sequence of pairs that is repeated Pn times.
+        auto decoded = std::string{};
+        auto repeat_count = 0;
+        auto repeat_start = std::string::npos;
+        for (auto i = std::size_t{0}; i < data.length(); i++) {
+            const auto ch = data[i];
+            if (ch == '!') {
+                repeat_count = 0;
+                while (++i < data.length() && data[i] >= '0' && data[i] <= '9')
+                    repeat_count = repeat_count * 10 + (data[i] - '0');
+                repeat_count = std::max(repeat_count, 1);
+                repeat_start = decoded.length();
+            } else if (ch == ';') {
+                if (repeat_start != std::string::npos) {
+                    const auto repeated = decoded.substr(repeat_start);
+                    for (auto n = 1; n < repeat_count; n++)
+                        decoded += repeated;
+                    repeat_start = std::string::npos;
+                }
+            } else if (i + 1 < data.length() && hex_value(ch) >= 0 && hex_value(data[i + 1]) >= 0) {
+                decoded += char(hex_value(ch) * 16 + hex_value(data[i + 1]));
+                i++;
+            }
+        }
+        return decoded;
+    }
+
+}  // namespace
+
+int vt525::image::at(const int x, const int y) const
+{
+    if (x < 0 || y < 0 || x >= width || y >= height) return -1;
+    return pixels[y * width + x];
+}
+
+vt525::vt525()
+    : vt525(options{})
+{
+}
+
+vt525::vt525(const options& opts)
+    : _options{opts}, _color_table{default_color_table}
+{
+    _pages.assign(_options.page_count, std::vector<cell>(_options.width * _options.height));
+}
+
+void vt525::write(const std::string_view data)
+{
+    _bytes_received += data.length();
+    for (const auto ch : data)
+        _process(ch);
+}
+
+std::string vt525::take_replies()
+{
+    return std::exchange(_replies, {});
+}
+
+int vt525::width() const
+{
+    return _options.width;
+}
+
+int vt525::height() const
+{
+    return _options.height;
+}
+
+int vt525::page_count() const
+{
+    return _options.page_count;
+}
+
+const vt525::cell& vt525::at(const int page, const int row, const int col) const
+{
+    return _pages.at(page - 1).at((row - 1) * _options.width + col - 1);
+}
+
+std::string vt525::text(const int page, const int row) const
+{
+    auto s = std::string{};
+    for (auto col = 1; col <= _options.width; col++)
+        s += at(page, row, col).ch;
+    return s;
+}
+
+const std::vector<vt525::image>& vt525::images() const
+{
+    return _images;
+}
+
+void vt525::clear_images()
+{
+    _images.clear();
+}
+
+const std::string& vt525::color_table() const
+{
+    return _color_table;
+}
+
+const std::string& vt525::title() const
+{
+    return _title;
+}
+
+std::optional<std::string> vt525::glyph(const std::string_view id, const int index) const
+{
+    const auto font = _fonts.find(id);
+    if (font == _fonts.end() || index < 0 || index >= 96) return {};
+    return font->second[index];
+}
+
+int vt525::macro_count() const
+{
+    return int(_macros.size());
+}
+
+int vt525::macro_space_used() const
+{
+    auto used = std::size_t{0};
+    for (const auto& [id, content] : _macros)
+        used += content.length();
+    return int(used);
+}
+
+int vt525::undefined_macro_invocations() const
+{
+    return _undefined_invocations;
+}
+
+std::size_t vt525::bytes_received() const
+{
+    return _bytes_received;
+}
+
+int vt525::sequence_count(const std::string_view name) const
+{
+    const auto it = _sequence_counts.find(name);
+    return it != _sequence_counts.end() ? it->second : 0;
+}
+
+const std::map<std::string, int, std::less<>>& vt525::sequence_counts() const
+{
+    return _sequence_counts;
+}
+
+void vt525::reset_counts()
+{
+    _bytes_received = 0;
+    _sequence_counts.clear();
+}
+
+void vt525::_process(const char ch)
+{
+    // CAN and SUB abort any sequence in progress.
+    if (ch == '\030' || ch == '\032') {
+        _state = state::ground;
+        return;
+    }
+    switch (_state) {
+        case state::ground:
+            if (ch == '\033') {
+                _intermediates.clear();
+                _state = state::escape;
+            } else if (uint8_t(ch) < 0x20) {
+                _execute(ch);
+            } else {
+                _print(ch);
+            }
+            return;
+        case state::escape:
+            if (ch == '\033') return;
+            if (uint8_t(ch) < 0x20) {
+                _execute(ch);
+            } else if (ch >= ' ' && ch <= '/') {
+                _intermediates += ch;
+            } else if (_intermediates.empty() && (ch == '[' || ch == 'P' || ch == ']')) {
+                _prefix = 0;
+                _parms.clear();
+                _parm_started = false;
+                _final = 0;
+                _data.clear();
+                _state = ch == '[' ? state::csi : ch == 'P' ? state::dcs : state::osc;
+            } else {
+                _final = ch;
+                _state = state::ground;
+                _dispatch_escape();
+                _intermediates.clear();
+            }
+            return;
+        case state::csi:
+        case state::dcs:
+            if (ch == '\033') {
+                _intermediates.clear();
+                _state = state::escape;
+            } else if (uint8_t(ch) < 0x20) {
+                _execute(ch);
+            } else if (ch >= '0' && ch <= '9') {
+                if (!_parm_started) _parms.push_back(0);
+                _parm_started = true;
+                _parms.back() = std::min(_parms.back() * 10 + (ch - '0'), 65535);
+            } else if (ch == ';') {
+                if (!_parm_started) _parms.push_back(0);
+                _parm_started = false;
+            } else if (ch >= '<' && ch <= '?') {
+                _prefix = ch;
+            } else if (ch >= ' ' && ch <= '/') {
+                _intermediates += ch;
+            } else if (ch >= '@' && ch <= '~') {
+                _final = ch;
+                if (_state == state::csi) {
+                    _state = state::ground;
+                    _dispatch_csi();
+                    _intermediates.clear();
+                } else {
+                    _state = state::dcs_data;
+                }
+            }
+            return;
+        case state::dcs_data:
+        case state::osc:
+            if (ch == '\033') {
+                _string_state = _state;
+                _state = state::string_escape;
+            } else if (ch == '\007' && _state == state::osc) {
+                _state = state::ground;
+                _dispatch_osc();
+            } else {
+                _data += ch;
+            }
+            return;
+        case state::string_escape:
+            if (ch == '\\') {
+                _state = state::ground;
+                if (_string_state == state::osc)
+                    _dispatch_osc();
+                else
+                    _dispatch_dcs();
+                _intermediates.clear();
+            } else {
+                // Anything other than ST aborts the string.
+                _intermediates.clear();
+                _state = state::escape;
+                _process(ch);
+            }
+            return;
+    }
+}
+
+void vt525::_print(const char ch)
+{
+    if (ch == '\177') return;
+    const auto margins = _margins();
+    const auto right = _in_margins() ? margins.right : _options.width;
+    if (_insert_mode) {
+        auto& page = _page(_active_page);
+        const auto row_start = (_cursor.row - 1) * _options.width;
+        for (auto col = right; col > _cursor.col; col--)
+            page[row_start + col - 1] = page[row_start + col - 2];
+    }
+    auto& cell = _cell(_active_page, _cursor.row, _cursor.col);
+    cell.ch = ch;
+    cell.charset = _cursor.gsets[_cursor.gl];
+    cell.attrs = _cursor.attrs;
+    if (_cursor.col < right)
+        _cursor.col++;
+    else if (_private_modes[7]) {
+        _cursor.col = _in_margins() ? margins.left : 1;
+        _linefeed();
+    }
+}
+
+void vt525::_execute(const char ch)
+{
+    switch (ch) {
+        case '\b':
+            _cursor.col = std::max(_cursor.col - 1, 1);
+            break;
+        case '\t':
+            _cursor.col = std::min((_cursor.col + 7) / 8 * 8 + 1, _options.width);
+            break;
+        case '\n':
+        case '\v':
+        case '\f':
+            _linefeed();
+            break;
+        case '\r':
+            _cursor.col = _in_margins() ? _margins().left : 1;
+            break;
+        case '\016':
+            _count("LS1");
+            _cursor.gl = 1;
+            break;
+        case '\017':
+            _count("LS0");
+            _cursor.gl = 0;
+            break;
+    }
+}
+
+void vt525::_dispatch_escape()
+{
+    if (!_intermediates.empty()) {
+        const auto gset = std::string_view{"()*+,-./"}.find(_intermediates[0]);
+        if (gset != std::string_view::npos) {
+            _count(gset < 4 ? "SCS" : "SCS96");
+            _cursor.gsets[gset % 4] = _intermediates.substr(1) + _final;
+        } else if (_intermediates == " " && _final == 'F') {
+            _count("S7C1T");
+        }
+        return;
+    }
+    switch (_final) {
+        case '7':
+            _count("DECSC");
+            _saved_cursor = _cursor;
+            break;
+        case '8':
+            _count("DECRC");
+            if (_saved_cursor) _cursor = _saved_cursor.value();
+            break;
+        case '9':
+            _count("DECFI");
+            if (_cursor.col < _options.width) _cursor.col++;
+            break;
+        case 'n':
+            _count("LS2");
+            _cursor.gl = 2;
+            break;
+        case 'o':
+            _count("LS3");
+            _cursor.gl = 3;
+            break;
+    }
+}
+
+void vt525::_dispatch_csi()
+{
+    const auto id = std::string{_prefix ? std::string(1, _prefix) : ""} + _intermediates + _final;
+    if (id == "H" || id == "f") {
+        _count("CUP");
+        _cup(_parm(0, 1), _parm(1, 1));
+    } else if (id == "C") {
+        _count("CUF");
+        const auto right = _in_margins() ? _margins().right : _options.width;
+        _cursor.col = std::min(_cursor.col + _parm(0, 1), right);
+    } else if (id == "D") {
+        _count("CUB");
+        const auto left = _in_margins() ? _margins().left : 1;
+        _cursor.col = std::max(_cursor.col - _parm(0, 1), left);
+    } else if (id == "J") {
+        _count("ED");
+        _ed(_parm(0));
+    } else if (id == "L") {
+        _count("IL");
+        _il(_parm(0, 1));
+    } else if (id == "m") {
+        _count("SGR");
+        _sgr(_cursor.attrs, _parms, 0);
+    } else if (id == " P") {
+        _count("PPA");
+        _active_page = std::clamp(_parm(0, 1), 1, _options.page_count);
+    } else if (id == "h" || id == "?h") {
+        _count("SM");
+        _mode(true);
+    } else if (id == "l" || id == "?l") {
+        _count("RM");
+        _mode(false);
+    } else if (id == "n" || id == "?n") {
+        _count("DSR");
+        _dsr();
+    } else if (id == "?c" || id == "c") {
+        _count("DA");
+        if (_prefix == 0 && _parm(0) == 0)
+            _reply(std::string{device_attributes} + (_options.has_sixel ? ";4c" : "c"));
+    } else if (id == "'}") {
+        _count("DECIC");
+        _decic(_parm(0, 1));
+    } else if (id == "*x") {
+        _count("DECSACE");
+    } else if (id == "?$p") {
+        _count("DECRQM");
+        const auto mode = _parm(0);
+        auto status = 0;
+        if (_private_modes.contains(mode))
+            status = _private_modes[mode] ? 1 : 2;
+        else if (std::ranges::find(known_private_modes, mode) != known_private_modes.end())
+            status = 2;
+        _reply("\033[?" + std::to_string(mode) + ';' + std::to_string(status) + "$y");
+    } else if (id == ",|") {
+        _count("DECAC");
+    } else if (id == "$u") {
+        _count("DECCTR");
+        if (_parm(0) == 2) _reply("\033P2$s" + _color_table + "\033\\");
+    } else if (id == "r") {
+        _count("DECSTBM");
+        const auto top = _parm(0, 1);
+        const auto bottom = _parm(1, _options.height);
+        if (top < bottom && bottom <= _options.height) {
+            _top_margin = top;
+            _bottom_margin = bottom;
+            _cup(1, 1);
+        }
+    } else if (id == "s") {
+        if (!_private_modes[69]) return;
+        _count("DECSLRM");
+        const auto left = _parm(0, 1);
+        const auto right = _parm(1, _options.width);
+        if (left < right && right <= _options.width) {
+            _left_margin = left;
+            _right_margin = right;
+            _cup(1, 1);
+        }
+    } else if (id == "$x") {
+        _count("DECFRA");
+        _decfra();
+    } else if (id == "$v") {
+        _count("DECCRA");
+        _deccra();
+    } else if (id == "$r") {
+        _count("DECCARA");
+        _deccara();
+    } else if (id == "*z") {
+        _count("DECINVM");
+        _decinvm(_parm(0));
+    } else {
+        _count("CSI " + id);
+    }
+}
+
+void vt525::_dispatch_dcs()
+{
+    const auto id = std::string{_prefix ? std::string(1, _prefix) : ""} + _intermediates + _final;
+    if (id == "!z") {
+        _count("DECDMAC");
+        _decdmac();
+    } else if (id == "{") {
+        _count("DECDLD");
+        _decdld();
+    } else if (id == "q") {
+        _count("SIXEL");
+        _sixel();
+    } else if (id == "$p" && _parm(0) == 2) {
+        _count("DECRSTS");
+        _restore_color_table();
+    } else {
+        _count("DCS " + id);
+    }
+}
+
+void vt525::_dispatch_osc()
+{
+    if (_data.starts_with("21;")) {
+        _count("DECSWT");
+        _title = _data.substr(3);
+    } else {
+        _count("OSC");
+    }
+}
+
+void vt525::_count(const std::string_view name)
+{
+    // Sequences executed from a macro aren't counted, since they never went
+    // over the wire.
+    if (_macro_depth > 0) return;
+    const auto it = _sequence_counts.find(name);
+    if (it != _sequence_counts.end())
+        it->second++;
+    else
+        _sequence_counts.emplace(name, 1);
+}
+
+void vt525::_reply(const std::string_view s)
+{
+    _replies += s;
+}
+
+void vt525::_cup(const int row, const int col)
+{
+    if (_cursor.origin_mode) {
+        const auto margins = _margins();
+        _cursor.row = std::min(margins.top + row - 1, margins.bottom);
+        _cursor.col = std::min(margins.left + col - 1, margins.right);
+    } else {
+        _cursor.row = std::min(row, _options.height);
+        _cursor.col = std::min(col, _options.width);
+    }
+}
+
+void vt525::_linefeed()
+{
+    if (_cursor.row == _margins().bottom)
+        _scroll_up();
+    else if (_cursor.row < _options.height)
+        _cursor.row++;
+}
+
+void vt525::_scroll_up()
+{
+    const auto margins = _margins();
+    for (auto row = margins.top; row < margins.bottom; row++)
+        for (auto col = margins.left; col <= margins.right; col++)
+            _cell(_active_page, row, col) = _cell(_active_page, row + 1, col);
+    for (auto col = margins.left; col <= margins.right; col++)
+        _cell(_active_page, margins.bottom, col) = _blank();
+}
+
+void vt525::_sgr(attributes& attrs, const std::vector<int>& parms, const std::size_t start)
+{
+    if (parms.size() <= start) {
+        attrs = {};
+        return;
+    }
+    for (auto i = start; i < parms.size(); i++) {
+        const auto parm = parms[i];
+        if (parm == 0)
+            attrs = {};
+        else if (parm == 1)
+            attrs.bold = true;
+        else if (parm == 4)
+            attrs.underline = true;
+        else if (parm == 5)
+            attrs.blink = true;
+        else if (parm == 7)
+            attrs.reverse = true;
+        else if (parm == 22)
+            attrs.bold = false;
+        else if (parm == 24)
+            attrs.underline = false;
+        else if (parm == 25)
+            attrs.blink = false;
+        else if (parm == 27)
+            attrs.reverse = false;
+        else if (parm >= 30 && parm <= 37)
+            attrs.foreground = parm - 30;
+        else if (parm == 39)
+            attrs.foreground = -1;
+        else if (parm >= 40 && parm <= 47)
+            attrs.background = parm - 40;
+        else if (parm == 49)
+            attrs.background = -1;
+    }
+}
+
+void vt525::_mode(const bool set)
+{
+    for (const auto mode : _parms) {
+        if (_prefix == '?') {
+            _private_modes[mode] = set;
+            if (mode == 6) {
+                _cursor.origin_mode = set;
+                _cup(1, 1);
+            } else if (mode == 69 && !set) {
+                _left_margin = 1;
+                _right_margin = 0;
+            }
+        } else if (mode == 4) {
+            _insert_mode = set;
+        }
+    }
+}
+
+void vt525::_dsr()
+{
+    const auto id = _parm(0);
+    const auto margins = _margins();
+    const auto row = _cursor.origin_mode ? _cursor.row - margins.top + 1 : _cursor.row;
+    const auto col = _cursor.origin_mode ? _cursor.col - margins.left + 1 : _cursor.col;
+    if (_prefix == 0 && id == 6) {
+        _reply("\033[" + std::to_string(row) + ';' + std::to_string(col) + 'R');
+    } else if (_prefix == '?' && id == 6) {
+        _reply("\033[?" + std::to_string(row) + ';' + std::to_string(col) + ';' + std::to_string(_active_page) + 'R');
+    } else if (_prefix == '?' && id == 26) {
+        // A North American PC keyboard (PCXAL).
+        _reply("\033[?27;1;0;5n");
+    } else if (_prefix == '?' && id == 62) {
+        const auto available = std::max(_options.macro_space - macro_space_used(), 0);
+        _reply("\033[" + std::to_string(available / 16) + "*{");
+    }
+}
+
+void vt525::_il(const int count)
+{
+    const auto margins = _margins();
+    if (!_in_margins() || _cursor.row < margins.top || _cursor.row > margins.bottom) return;
+    for (auto row = margins.bottom; row >= _cursor.row; row--)
+        for (auto col = margins.left; col <= margins.right; col++)
+            _cell(_active_page, row, col) = row - count >= _cursor.row ? _cell(_active_page, row - count, col) : _blank();
+    _cursor.col = margins.left;
+}
+
+void vt525::_decic(const int count)
+{
+    const auto margins = _margins();
+    if (!_in_margins()) return;
+    for (auto row = margins.top; row <= margins.bottom; row++)
+        for (auto col = margins.right; col >= _cursor.col; col--)
+            _cell(_active_page, row, col) = col - count >= _cursor.col ? _cell(_active_page, row, col - count) : _blank();
+}
+
+void vt525::_ed(const int type)
+{
+    const auto cursor_index = (_cursor.row - 1) * _options.width + _cursor.col - 1;
+    auto& page = _page(_active_page);
+    for (auto i = 0; i < int(page.size()); i++) {
+        const auto erase = type == 2 || (type == 0 && i >= cursor_index) || (type == 1 && i <= cursor_index);
+        if (erase) page[i] = _blank();
+    }
+}
+
+std::optional<vt525::rectangle> vt525::_rectangle(const std::size_t start) const
+{
+    // Rectangle coordinates are relative to the margins in origin mode, and
+    // clamped to the margins, or the page if origin mode isn't set.
+    const auto bounds = _bounds();
+    auto rect = rectangle{};
+    rect.top = bounds.top + _parm(start, 1) - 1;
+    rect.left = bounds.left + _parm(start + 1, 1) - 1;
+    rect.bottom = std::min(bounds.top + _parm(start + 2, _options.height) - 1, bounds.bottom);
+    rect.right = std::min(bounds.left + _parm(start + 3, _options.width) - 1, bounds.right);
+    if (rect.top > rect.bottom || rect.left > rect.right) return {};
+    return rect;
+}
+
+void vt525::_decfra()
+{
+    const auto ch = _parm(0, ' ');
+    const auto rect = _rectangle(1);
+    if (!rect || !((ch >= 32 && ch <= 126) || ch >= 160)) return;
+    for (auto row = rect->top; row <= rect->bottom; row++) {
+        for (auto col = rect->left; col <= rect->right; col++) {
+            auto& cell = _cell(_active_page, row, col);
+            cell.ch = char(ch);
+            cell.charset = _cursor.gsets[_cursor.gl];
+            cell.attrs = _cursor.attrs;
+        }
+    }
+}
+
+void vt525::_deccara()
+{
+    const auto rect = _rectangle(0);
+    if (!rect) return;
+    for (auto row = rect->top; row <= rect->bottom; row++)
+        for (auto col = rect->left; col <= rect->right; col++)
+            _sgr(_cell(_active_page, row, col).attrs, _parms, 4);
+}
+
+void vt525::_deccra()
+{
+    const auto source = _rectangle(0);
+    if (!source) return;
+    const auto source_page = std::clamp(_parm(4, 1), 1, _options.page_count);
+    const auto bounds = _bounds();
+    const auto target_top = bounds.top + _parm(5, 1) - 1;
+    const auto target_left = bounds.left + _parm(6, 1) - 1;
+    const auto target_page = std::clamp(_parm(7, 1), 1, _options.page_count);
+    // The source is copied first, so overlapping rectangles are handled.
+    auto cells = std::vector<cell>{};
+    for (auto row = source->top; row <= source->bottom; row++)
+        for (auto col = source->left; col <= source->right; col++)
+            cells.push_back(_cell(source_page, row, col));
+    auto i = 0;
+    for (auto row = source->top; row <= source->bottom; row++) {
+        for (auto col = source->left; col <= source->right; col++) {
+            const auto target_row = target_top + row - source->top;
+            const auto target_col = target_left + col - source->left;
+            if (target_row <= bounds.bottom && target_col <= bounds.right)
+                _cell(target_page, target_row, target_col) = cells[i];
+            i++;
+        }
+    }
+}
+
+void vt525::_decdmac()
+{
+    const auto id = _parm(0);
+    const auto delete_type = _parm(1);
+    const auto encoding = _parm(2);
+    if (delete_type == 1) _macros.clear();
+    _macros.erase(id);
+    if (_data.empty() || id > 63) return;
+    auto content = encoding == 1 ? decode_hex(_data) : _data;
+    // A macro that doesn't fit in the available space is discarded.
+    if (macro_space_used() + int(content.length()) > _options.macro_space) return;
+    _macros[id] = std::move(content);
+}
+
+void vt525::_decinvm(const int id)
+{
+    const auto macro = _macros.find(id);
+    // Invoking an undefined macro is harmless on a real terminal, but it
+    // means the application's view of the macro space is wrong, so these
+    // are counted even when nested.
+    if (macro == _macros.end()) _undefined_invocations++;
+    if (macro == _macros.end() || _macro_depth >= 16) return;
+    // The content is copied, since the macro could redefine itself.
+    const auto content = macro->second;
+    _macro_depth++;
+    for (const auto ch : content)
+        _process(ch);
+    _macro_depth--;
+}
+
+void vt525::_decdld()
+{
+    const auto first_index = _parm(1);
+    const auto erase = _parm(2);
+    // The Dscs is up to two intermediates followed by a final character.
+    auto i = std::size_t{0};
+    while (i < _data.length() && _data[i] >= ' ' && _data[i] <= '/' && i < 2)
+        i++;
+    if (i >= _data.length()) return;
+    const auto id = _data.substr(0, i + 1);
+    auto& font = _fonts[id];
+    if (erase == 0 || erase == 2) font.fill({});
+    if (erase == 2) {
+        for (auto& [other_id, other_font] : _fonts)
+            other_font.fill({});
+    }
+    auto index = first_index;
+    auto glyph = std::string{};
+    for (i++; i <= _data.length(); i++) {
+        if (i == _data.length() || _data[i] == ';') {
+            if (index >= 0 && index < 96) font[index] = glyph;
+            glyph.clear();
+            index++;
+        } else {
+            glyph += _data[i];
+        }
+    }
+}
+
+void vt525::_restore_color_table()
+{
+    // Only the entries included in the report are updated, so we merge them
+    // with the existing table, which is kept ordered by color index.
+    auto entries = std::map<int, std::string>{};
+    const auto merge = [&](const std::string_view table) {
+        for (auto start = std::size_t{0}; start < table.length();) {
+            auto end = table.find('/', start);
+            if (end == std::string_view::npos) end = table.length();
+            const auto entry = table.substr(start, end - start);
+            if (!entry.empty()) entries[std::atoi(std::string{entry}.c_str())] = entry;
+            start = end + 1;
+        }
+    };
+    merge(_color_table);
+    merge(_data);
+    _color_table.clear();
+    for (const auto& [index, entry] : entries) {
+        if (!_color_table.empty()) _color_table += '/';
+        _color_table += entry;
+    }
+}
+
+void vt525::_sixel()
+{
+    auto img = image{};
+    img.page = _active_page;
+    img.row = _cursor.row;
+    img.col = _cursor.col;
+    auto x = 0;
+    auto band = 0;
+    auto color = 0;
+    auto pixels = std::map<std::pair<int, int>, int>{};
+    const auto number = [&](std::size_t& i) {
+        auto n = 0;
+        while (i < _data.length() && _data[i] >= '0' && _data[i] <= '9')
+            n = n * 10 + (_data[i++] - '0');
+        return n;
+    };
+    for (auto i = std::size_t{0}; i < _data.length();) {
+        const auto ch = _data[i++];
+        if (ch == '"') {
+            // Raster attributes: Pan;Pad;Ph;Pv
+            auto values = std::vector<int>{};
+            do {
+                values.push_back(number(i));
+            } while (i < _data.length() && _data[i] == ';' && ++i);
+            if (values.size() >= 4) {
+                img.width = values[2];
+                img.height = values[3];
+            }
+        } else if (ch == '#') {
+            color = number(i);
+            // Color definitions are skipped, since we only track the index.
+            while (i < _data.length() && _data[i] == ';') {
+                i++;
+                number(i);
+            }
+        } else if (ch == '!' || (ch >= '?' && ch <= '~')) {
+            auto count = 1;
+            auto sixel = ch;
+            if (ch == '!') {
+                count = number(i);
+                if (i >= _data.length()) break;
+                sixel = _data[i++];
+            }
+            const auto bits = sixel - '?';
+            for (auto n = 0; n < count; n++, x++)
+                for (auto bit = 0; bit < 6; bit++)
+                    if (bits & (1 << bit)) pixels[{x, band * 6 + bit}] = color;
+        } else if (ch == '$') {
+            x = 0;
+        } else if (ch == '-') {
+            x = 0;
+            band++;
+        }
+    }
+    for (const auto& [position, color] : pixels) {
+        img.width = std::max(img.width, position.first + 1);
+        img.height = std::max(img.height, position.second + 1);
+    }
+    img.pixels.assign(img.width * img.height, -1);
+    for (const auto& [position, color] : pixels)
+        img.pixels[position.second * img.width + position.first] = color;
+    _images.push_back(std::move(img));
+}
+
+int vt525::_parm(const std::size_t index, const int default_value) const
+{
+    return index < _parms.size() && _parms[index] ? _parms[index] : default_value;
+}
+
+vt525::margins vt525::_margins() const
+{
+    auto m = margins{};
+    m.top = _top_margin;
+    m.bottom = _bottom_margin ? _bottom_margin : _options.height;
+    m.left = _left_margin;
+    m.right = _right_margin ? _right_margin : _options.width;
+    return m;
+}
+
+vt525::margins vt525::_bounds() const
+{
+    if (_cursor.origin_mode) return _margins();
+    return {1, _options.height, 1, _options.width};
+}
+
+bool vt525::_in_margins() const
+{
+    const auto margins = _margins();
+    return _cursor.col >= margins.left && _cursor.col <= margins.right;
+}
+
+std::vector<vt525::cell>& vt525::_page(const int page)
+{
+    return _pages.at(page - 1);
+}
+
+vt525::cell& vt525::_cell(const int page, const int row, const int col)
+{
+    return _page(page).at((row - 1) * _options.width + col - 1);
+}
+
+vt525::cell vt525::_blank() const
+{
+    return {};
+}
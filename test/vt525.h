@@ -0,0 +1,185 @@
+// VT Font Maker
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#pragma once
+
+#include <array>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A minimal in-process stand-in for a VT525, covering just the subset of
+// control functions that vt_stream emits. It answers the probes sent by the
+// capabilities and coloring classes, and keeps the cell and attribute grid of
+// every page, so tests can assert on the final screen content, and measure
+// the number of bytes and sequences used for each operation.
+class vt525 {
+public:
+    struct attributes {
+        bool bold = false;
+        bool underline = false;
+        bool blink = false;
+        bool reverse = false;
+        int foreground = -1;
+        int background = -1;
+        auto operator<=>(const attributes&) const = default;
+    };
+
+    struct cell {
+        char ch = ' ';
+        std::string charset = "B";
+        attributes attrs;
+        auto operator<=>(const cell&) const = default;
+    };
+
+    struct image {
+        int page = 1;
+        int row = 1;
+        int col = 1;
+        int width = 0;
+        int height = 0;
+        std::vector<int> pixels;
+        int at(const int x, const int y) const;
+    };
+
+    struct options {
+        int width = 80;
+        int height = 24;
+        int page_count = 6;
+        int macro_space = 8192;
+        bool has_sixel = false;
+    };
+
+    static constexpr int sixel_cell_width = 10;
+    static constexpr int sixel_cell_height = 20;
+
+    vt525();
+    vt525(const options& opts);
+    void write(const std::string_view data);
+    std::string take_replies();
+
+    int width() const;
+    int height() const;
+    int page_count() const;
+    const cell& at(const int page, const int row, const int col) const;
+    std::string text(const int page, const int row) const;
+    const std::vector<image>& images() const;
+    void clear_images();
+    const std::string& color_table() const;
+    const std::string& title() const;
+    std::optional<std::string> glyph(const std::string_view id, const int index) const;
+    int macro_count() const;
+    int macro_space_used() const;
+    int undefined_macro_invocations() const;
+
+    std::size_t bytes_received() const;
+    int sequence_count(const std::string_view name) const;
+    const std::map<std::string, int, std::less<>>& sequence_counts() const;
+    void reset_counts();
+
+private:
+    enum class state {
+        ground,
+        escape,
+        csi,
+        dcs,
+        dcs_data,
+        osc,
+        string_escape
+    };
+
+    struct margins {
+        int top;
+        int bottom;
+        int left;
+        int right;
+    };
+
+    struct cursor_state {
+        int row = 1;
+        int col = 1;
+        attributes attrs;
+        std::array<std::string, 4> gsets = {"B", "B", "B", "B"};
+        int gl = 0;
+        bool origin_mode = false;
+    };
+
+    struct rectangle {
+        int top;
+        int left;
+        int bottom;
+        int right;
+    };
+
+    void _process(const char ch);
+    void _print(const char ch);
+    void _execute(const char ch);
+    void _dispatch_escape();
+    void _dispatch_csi();
+    void _dispatch_dcs();
+    void _dispatch_osc();
+    void _count(const std::string_view name);
+    void _reply(const std::string_view s);
+
+    void _cup(const int row, const int col);
+    void _linefeed();
+    void _scroll_up();
+    void _sgr(attributes& attrs, const std::vector<int>& parms, const std::size_t start);
+    void _mode(const bool set);
+    void _dsr();
+    void _il(const int count);
+    void _decic(const int count);
+    void _ed(const int type);
+    std::optional<rectangle> _rectangle(const std::size_t start) const;
+    void _decfra();
+    void _deccara();
+    void _deccra();
+    void _decdmac();
+    void _decinvm(const int id);
+    void _decdld();
+    void _restore_color_table();
+    void _sixel();
+
+    int _parm(const std::size_t index, const int default_value = 0) const;
+    margins _margins() const;
+    margins _bounds() const;
+    bool _in_margins() const;
+    std::vector<cell>& _page(const int page);
+    cell& _cell(const int page, const int row, const int col);
+    cell _blank() const;
+
+    options _options;
+    std::vector<std::vector<cell>> _pages;
+    int _active_page = 1;
+    cursor_state _cursor;
+    std::optional<cursor_state> _saved_cursor;
+    std::map<int, bool> _private_modes;
+    bool _insert_mode = false;
+    int _top_margin = 1;
+    int _bottom_margin = 0;
+    int _left_margin = 1;
+    int _right_margin = 0;
+    std::map<int, std::string> _macros;
+    std::map<std::string, std::array<std::string, 96>, std::less<>> _fonts;
+    std::vector<image> _images;
+    std::string _color_table;
+    std::string _title;
+    int _macro_depth = 0;
+    int _undefined_invocations = 0;
+
+    state _state = state::ground;
+    char _prefix = 0;
+    std::vector<int> _parms;
+    bool _parm_started = false;
+    std::string _intermediates;
+    char _final = 0;
+    std::string _data;
+    state _string_state = state::ground;
+
+    std::string _replies;
+    std::size_t _bytes_received = 0;
+    std::map<std::string, int, std::less<>> _sequence_counts;
+};